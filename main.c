@@ -11,6 +11,8 @@ extern int isatty(int fd);
 #include "src/header/environment.h"
 #include "src/header/write.h"
 #include "src/header/error.h"
+#include "src/header/gc.h"
+#include "src/header/vm.h"
 
 void print_prompt() {
     printf("Welcome to Toy-Scheme\nPress Ctrl-C to exit\n");
@@ -22,6 +24,32 @@ static bool has_scm_suffix(const char* path) {
     return filename_len >= 4 && strcmp(path + filename_len - 4, ".scm") == 0;
 }
 
+/* a collector thread count, from TOY_SCHEME_GC_THREADS or -gc-threads */
+static size_t parse_gc_threads(const char* text) {
+    char* end;
+    unsigned long threads = strtoul(text, &end, 10);
+
+    if(*text == '\0' || *end != '\0' || threads == 0 || threads > GC_MAX_THREADS) {
+        char buf[80];
+        sprintf(buf, "the collector thread count must be between 1 and %d\n", GC_MAX_THREADS);
+        error_handle(stderr, buf, EXIT_FAILURE);
+    }
+    return (size_t) threads;
+}
+
+/* the number of gray objects one marking step scans, from -gc-step */
+static size_t parse_gc_step(const char* text) {
+    char* end;
+    unsigned long step = strtoul(text, &end, 10);
+
+    if(*text == '\0' || *end != '\0' || step == 0 || step > GC_MAX_MARK_STEP) {
+        char buf[80];
+        sprintf(buf, "-gc-step requires a number between 1 and %d\n", GC_MAX_MARK_STEP);
+        error_handle(stderr, buf, EXIT_FAILURE);
+    }
+    return (size_t) step;
+}
+
 void repl() {
     jmp_buf recovery_point;
     object* obj, * result;
@@ -34,7 +62,7 @@ void repl() {
 
     for(; ;) {
         if(setjmp(recovery_point) != 0) {
-            gc_collect();
+            gc_safepoint();
         }
         if(!use_readline_prompt) {
             printf("> ");
@@ -53,7 +81,7 @@ void repl() {
             printf("\n");
             fflush(stdout);
         }
-        gc_collect();
+        gc_safepoint();
     }
     clear_error_recovery();
 }
@@ -83,7 +111,7 @@ static void eval_source_file(FILE* source_file) {
         object* result;
 
         if(setjmp(recovery_point) != 0) {
-            gc_collect();
+            gc_safepoint();
             if(list->token_pointer == token_before && list->token_pointer != NULL)
                 list_iter(list);
             continue;
@@ -98,13 +126,58 @@ static void eval_source_file(FILE* source_file) {
             printf("\n");
             fflush(stdout);
         }
-        gc_collect();
+        gc_safepoint();
     }
     clear_error_recovery();
     destroy_token_list(list);
 }
 
 int main(int argc, char** argv) {
+    bool gc_threads_given = false;
+
+    /* the collector scans the C stack below main for objects in use */
+#ifdef __GNUC__
+    gc_set_stack_base(__builtin_frame_address(0));
+#else
+    gc_set_stack_base(&argc);
+#endif
+
+    /*
+     * options come first: everything runs on the bytecode VM, -tree selects
+     * the tree-walking evaluator, a debugging aid that recurses on the C
+     * stack and only has escaping continuations; -gc-stats reports the
+     * collector pauses, -gc-step sets how many objects one marking step
+     * scans and -gc-threads how many threads collect big heaps in
+     * parallel, which TOY_SCHEME_GC_THREADS sets when the option is not
+     * given
+     */
+    while(argc > 1) {
+        if(strcmp(argv[1], "-vm") == 0 || strcmp(argv[1], "-tree") == 0) {
+            vm_enabled = strcmp(argv[1], "-vm") == 0;
+        }
+        else if(strcmp(argv[1], "-gc-stats") == 0) {
+            gc_report_pauses = true;
+            atexit(gc_report);
+        }
+        else if(strcmp(argv[1], "-gc-step") == 0 && argc > 2) {
+            gc_mark_step = parse_gc_step(argv[2]);
+            argv++;
+            argc--;
+        }
+        else if(strcmp(argv[1], "-gc-threads") == 0 && argc > 2) {
+            gc_threads = parse_gc_threads(argv[2]);
+            gc_threads_given = true;
+            argv++;
+            argc--;
+        }
+        else {
+            break;
+        }
+        argv++;
+        argc--;
+    }
+    if(!gc_threads_given && getenv("TOY_SCHEME_GC_THREADS") != NULL)
+        gc_threads = parse_gc_threads(getenv("TOY_SCHEME_GC_THREADS"));
 
     if(argc == 1) {
         init_built_in();
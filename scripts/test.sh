@@ -5,6 +5,10 @@ SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 PROJECT_ROOT="$(cd "${SCRIPT_DIR}/.." && pwd)"
 BUILD_DIR="${BUILD_DIR:-${PROJECT_ROOT}/build}"
 BIN_PATH="${BUILD_DIR}/Toy-Scheme"
+# extra interpreter flags passed before -f
+SCHEME_FLAGS="${SCHEME_FLAGS:-}"
+# the cases with big heaps also go through the parallel collector
+export TOY_SCHEME_GC_THREADS="${TOY_SCHEME_GC_THREADS:-4}"
 CASES_DIR="${PROJECT_ROOT}/tests/cases"
 EXPECTED_DIR="${PROJECT_ROOT}/tests/expected"
 REPL_CASES_DIR="${PROJECT_ROOT}/tests/repl"
@@ -60,7 +64,7 @@ for case_file in "${case_files[@]}"; do
         continue
     fi
 
-    printf '' | "${BIN_PATH}" -f "${case_file}" > "${raw_file}" 2>&1 || true
+    printf '' | "${BIN_PATH}" ${SCHEME_FLAGS} -f "${case_file}" > "${raw_file}" 2>&1 || true
 
     awk '
         function strip_prompts(line) {
@@ -100,7 +104,7 @@ for repl_case_file in "${repl_case_files[@]}"; do
         continue
     fi
 
-    cat "${repl_case_file}" | "${BIN_PATH}" > "${raw_file}" 2>&1 || true
+    cat "${repl_case_file}" | "${BIN_PATH}" ${SCHEME_FLAGS} > "${raw_file}" 2>&1 || true
 
     awk '
         function strip_prompts(line) {
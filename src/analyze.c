@@ -0,0 +1,786 @@
+//
+// syntactic analysis of expressions into executable syntax nodes
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "header/analyze.h"
+#include "header/object.h"
+#include "header/eval.h"
+#include "header/environment.h"
+#include "header/macro.h"
+#include "header/builtin.h"
+#include "header/error.h"
+#include "header/gc.h"
+
+static object* analyze_sequence(object* exps, object* scope);
+static object* analyze_list(object* exps, object* scope);
+static object* analyze_quasiquote(object* exp, int depth, object* scope);
+
+/*
+ * Node handlers either return the value of the node, or return NULL
+ * after storing the node that is left to run in tail position and its
+ * environment through the two pointers. *node and *env are registered
+ * roots of the caller, execute.
+ */
+
+static object* execute_constant(object** node, object** env) {
+    (void) env;
+    return (*node)->data.node.first;
+}
+
+static object* execute_variable(object** node, object** env) {
+    return lookup_global_value((*node)->data.node.first, *env);
+}
+
+static object* execute_local_variable(object** node, object** env) {
+    return lookup_lexical_value((*node)->data.node.first,
+                                fixnum_value((*node)->data.node.third),
+                                *env);
+}
+
+static object* execute_quasiquote(object** node, object** env) {
+    return eval_quasiquote((*node)->data.node.first, *env, 1);
+}
+
+static object* execute_assignment(object** node, object** env) {
+    object* value = execute((*node)->data.node.second, *env);
+    set_global_value((*node)->data.node.first, value, *env);
+    return ok_symbol;
+}
+
+static object* execute_local_assignment(object** node, object** env) {
+    object* value = execute((*node)->data.node.second, *env);
+    set_lexical_value((*node)->data.node.first,
+                      fixnum_value((*node)->data.node.third),
+                      value,
+                      *env);
+    return ok_symbol;
+}
+
+static object* execute_definition(object** node, object** env) {
+    object* value = execute((*node)->data.node.second, *env);
+    define_variable((*node)->data.node.first, value, *env);
+    return ok_symbol;
+}
+
+static object* execute_local_definition(object** node, object** env) {
+    object* value = execute((*node)->data.node.second, *env);
+    define_lexical_value(fixnum_value((*node)->data.node.third), value, *env);
+    return ok_symbol;
+}
+
+static object* execute_define_syntax(object** node, object** env) {
+    return eval_define_syntax((*node)->data.node.first, *env);
+}
+
+static object* execute_if(object** node, object** env) {
+    if(is_true(execute((*node)->data.node.first, *env)))
+        *node = (*node)->data.node.second;
+    else
+        *node = (*node)->data.node.third;
+    return NULL;
+}
+
+static object* execute_lambda(object** node, object** env) {
+    return make_closure(*node, *env);
+}
+
+static object* execute_sequence(object** node, object** env) {
+    object* exps = (*node)->data.node.first;
+    size_t last = exps->data.vector.length - 1;
+
+    for(size_t i = 0; i < last; i++)
+        execute(exps->data.vector.elements[i], *env);
+    *node = exps->data.vector.elements[last];
+    return NULL;
+}
+
+static object* execute_and(object** node, object** env) {
+    object* exps = (*node)->data.node.first;
+    size_t last = exps->data.vector.length - 1;
+
+    for(size_t i = 0; i < last; i++)
+        if(is_false(execute(exps->data.vector.elements[i], *env)))
+            return false_obj;
+    *node = exps->data.vector.elements[last];
+    return NULL;
+}
+
+static object* execute_or(object** node, object** env) {
+    object* exps = (*node)->data.node.first;
+    size_t last = exps->data.vector.length - 1;
+
+    for(size_t i = 0; i < last; i++) {
+        object* value = execute(exps->data.vector.elements[i], *env);
+        if(is_true(value))
+            return value;
+    }
+    *node = exps->data.vector.elements[last];
+    return NULL;
+}
+
+/* evaluates the operands into a C array, registered as roots */
+static object* execute_primitive_argv(object* procedure, object* operands, object* env) {
+    object* argv[PRIMITIVE_ARGV_INLINE];
+    size_t argc = operands->data.vector.length;
+    object* result;
+
+    for(size_t i = 0; i < argc; i++) {
+        argv[i] = NULL;
+        gc_protect(argv[i]);
+    }
+    for(size_t i = 0; i < argc; i++)
+        argv[i] = execute(operands->data.vector.elements[i], env);
+    if(!primitive_arity_ok(procedure, argc))
+        primitive_arity_error(procedure, argc);
+    if(argc == 2 && procedure->data.primitive_proc.binary_fun != NULL)
+        result = (procedure->data.primitive_proc.binary_fun)(argv[0], argv[1]);
+    else
+        result = (procedure->data.primitive_proc.argv_fun)(argc, argv);
+    gc_unprotect(argc);
+    return result;
+}
+
+static object* execute_application(object** node, object** env) {
+    object* operator_node = (*node)->data.node.first;
+    object* operands;
+    object* procedure = NULL;
+    object* arguments = the_empty_list;
+    object* tail = the_empty_list;
+    object* result = NULL;
+
+    gc_protect(procedure);
+    gc_protect(arguments);
+    gc_protect(tail);
+
+    procedure = execute(operator_node, *env);
+
+    if(is_macro(procedure) && is_variable_node(operator_node)) {
+        gc_unprotect(3);
+        *node = macro_expansion(*node, procedure);
+        return NULL;
+    }
+
+    operands = application_operands(*node);
+
+    if(is_primitive_proc(procedure) && procedure->data.primitive_proc.argv_fun != NULL &&
+       operands->data.vector.length <= PRIMITIVE_ARGV_INLINE) {
+        result = execute_primitive_argv(procedure, operands, *env);
+        gc_unprotect(3);
+        return result;
+    }
+
+    for(size_t i = 0; i < operands->data.vector.length; i++) {
+        object* cell = cons(execute(operands->data.vector.elements[i], *env), the_empty_list);
+        if(is_empty_list(arguments))
+            arguments = cell;
+        else
+            set_cdr(tail, cell);
+        tail = cell;
+    }
+
+    if(is_primitive_proc(procedure)) {
+        result = apply_primitive_procedure(procedure, arguments);
+    }
+    else if(is_continuation(procedure)) {
+        continuation_point* point = procedure->data.continuation.point;
+        if(operands->data.vector.length != 1)
+            error_handle(stderr, "continuation expected exactly 1 value", EXIT_FAILURE);
+        if(!point->active)
+            error_handle(stderr, "inactive continuation", EXIT_FAILURE);
+        procedure->data.continuation.value = car(arguments);
+        gc_write_barrier(procedure, car(arguments));
+        gc_root_count = point->root_count;
+        longjmp(point->return_point, 1);
+    }
+    else if(is_compound_proc(procedure)) {
+        *env = extend_procedure_environment(procedure, arguments);
+        *node = procedure->data.compound_proc.body;
+    }
+    else {
+        error_handle_with_object(stderr,
+                                 "Unknown procedure type --EVAL",
+                                 EXIT_FAILURE,
+                                 procedure);
+    }
+
+    gc_unprotect(3);
+    return result;
+}
+
+static object* execute_error(object** node, object** env) {
+    (void) env;
+    error_handle(stderr, (*node)->data.node.first->data.string.value, EXIT_FAILURE);
+    return NULL;
+}
+
+static object* execute_invalid(object** node, object** env) {
+    (void) env;
+    error_handle_with_object(stderr,
+                             "Unknown expression type --EVAL",
+                             EXIT_FAILURE,
+                             (*node)->data.node.first);
+    return NULL;
+}
+
+object* execute(object* node, object* env) {
+    object* result;
+
+    gc_protect(node);
+    gc_protect(env);
+    do {
+        gc_safepoint();
+        result = node->data.node.handler(&node, &env);
+    } while(result == NULL);
+    gc_unprotect(2);
+    return result;
+}
+
+bool is_variable_node(object* node) {
+    return node->data.node.kind == NODE_VARIABLE ||
+           node->data.node.kind == NODE_LOCAL_VARIABLE;
+}
+
+/* a redefined macro is a new MACRO object, so the cache misses */
+object* macro_expansion(object* node, object* macro) {
+    object* cached = node->data.node.expansion;
+    object* form = node->data.node.third;
+    object* expansion;
+
+    if(cached != NULL && car(cached) == macro)
+        return cdr(cached);
+    expansion = analyze_in_scope(expand_macro_application(macro, car(form)), cdr(form));
+    node->data.node.expansion = cons(macro, expansion);
+    gc_write_barrier(node, node->data.node.expansion);
+    return expansion;
+}
+
+static size_t list_length(object* list) {
+    size_t length = 0;
+    for(; is_pair(list); list = cdr(list))
+        length++;
+    return length;
+}
+
+static bool list_contains(object* list, object* item) {
+    for(; is_pair(list); list = cdr(list))
+        if(car(list) == item)
+            return true;
+    return false;
+}
+
+static long list_index(object* list, object* item) {
+    long index = 0;
+
+    for(; is_pair(list); list = cdr(list), index++)
+        if(car(list) == item)
+            return index;
+    return -1;
+}
+
+static object* append_names(object* first, object* second) {
+    if(is_empty_list(first))
+        return second;
+    return cons(car(first), append_names(cdr(first), second));
+}
+
+/*
+ * The scope of an expression is the list of the procedures around it,
+ * innermost first. A level of the scope holds the names of the slots of
+ * its frame and, as its body is analyzed, the variables of enclosing
+ * procedures its closure has to capture, the names of its own that
+ * inner closures capture and the ones that are assigned.
+ *
+ * When the lambda has been analyzed its level is sealed with the list
+ * of the variables to box. Code analyzed after that, the expansion of a
+ * macro use that is only found at run time, cannot change what the
+ * closures capture or box any more.
+ *
+ * A body that applies a name with no binding yet may turn out to use a
+ * macro defined later, whose expansion can refer to any variable around
+ * it. Such a level, and every level around it, is open: its closure
+ * keeps the whole environment it was made in and every variable it
+ * captures is boxed, so that the expansion can find the variables it
+ * needs by name and share them with the other closures.
+ */
+#define SCOPE_NAMES       0  /* slot names, the parameters first */
+#define SCOPE_DEFINITIONS 1  /* the slot names of internal definitions */
+#define SCOPE_CAPTURES    2  /* the names of the closure frame, in order */
+#define SCOPE_CAPTURED    3
+#define SCOPE_ASSIGNED    4
+#define SCOPE_BOXED       5  /* #f until sealed */
+#define SCOPE_OPEN        6  /* #t once open */
+#define SCOPE_LEVEL_SIZE  7
+
+#define scope_field(level, field) ((level)->data.vector.elements[field])
+
+/* the address of a variable that a sealed closure does not capture */
+#define UNCAPTURED_ADDRESS (-1L)
+
+static object* make_scope_level(object* names, object* definitions) {
+    object* level = make_vector(SCOPE_LEVEL_SIZE, the_empty_list);
+
+    scope_field(level, SCOPE_NAMES) = names;
+    scope_field(level, SCOPE_DEFINITIONS) = definitions;
+    scope_field(level, SCOPE_BOXED) = false_obj;
+    scope_field(level, SCOPE_OPEN) = false_obj;
+    return level;
+}
+
+static bool is_sealed(object* level) {
+    return scope_field(level, SCOPE_BOXED) != false_obj;
+}
+
+static bool is_open(object* level) {
+    return scope_field(level, SCOPE_OPEN) != false_obj;
+}
+
+static void open_scope(object* scope) {
+    for(; is_pair(scope); scope = cdr(scope))
+        scope_field(car(scope), SCOPE_OPEN) = true_obj;
+}
+
+/* whether a variable the sealed levels of scope do not capture can be
+ * found by name; the innermost sealed level is open only if the levels
+ * around it are */
+static bool reaches_by_name(object* scope) {
+    for(; is_pair(scope); scope = cdr(scope))
+        if(is_sealed(car(scope)))
+            return is_open(car(scope));
+    return false;
+}
+
+static void note_name(object* level, int field, object* var) {
+    if(!list_contains(scope_field(level, field), var))
+        scope_field(level, field) = cons(var, scope_field(level, field));
+}
+
+/* the level of scope whose frame has a slot for var, or NULL */
+static object* binding_level(object* var, object* scope) {
+    for(; is_pair(scope); scope = cdr(scope))
+        if(list_contains(scope_field(car(scope), SCOPE_NAMES), var))
+            return car(scope);
+    return NULL;
+}
+
+/* a sealed level cannot box a variable that turns out to be both
+ * captured and assigned; an open one, which may be assigned by name,
+ * hands out no copies of unboxed variables any more */
+static bool keeps_boxes(object* level, object* var, bool capture, bool assignment) {
+    bool captured = capture || list_contains(scope_field(level, SCOPE_CAPTURED), var);
+    bool assigned = assignment || list_contains(scope_field(level, SCOPE_ASSIGNED), var);
+
+    if(!is_sealed(level) || list_contains(scope_field(level, SCOPE_BOXED), var))
+        return true;
+    if(is_open(level))
+        return !capture;
+    return !captured || !assigned;
+}
+
+/* whether the closures from the innermost level up to binding can
+ * still capture var */
+static bool can_capture(object* var, object* scope, object* binding) {
+    for(; car(scope) != binding; scope = cdr(scope))
+        if(is_sealed(car(scope)) && !list_contains(scope_field(car(scope), SCOPE_CAPTURES), var))
+            return false;
+    return true;
+}
+
+/* the slot of var in the closure frame of the innermost level, which
+ * captures it from the level around it */
+static size_t capture_slot(object* var, object* scope, object* binding) {
+    object* level = car(scope);
+    object* captures = scope_field(level, SCOPE_CAPTURES);
+    long slot = list_index(captures, var);
+
+    if(slot >= 0)
+        return (size_t) slot;
+    if(cadr(scope) != binding)
+        capture_slot(var, cdr(scope), binding);
+    scope_field(level, SCOPE_CAPTURES) = append_names(captures, cons(var, the_empty_list));
+    return list_length(captures);
+}
+
+/*
+ * Finds the lexical address of var, a local variable when the result is
+ * true, and records its use. *address is UNCAPTURED_ADDRESS when that
+ * would need a sealed closure to change.
+ */
+static bool resolve_variable(object* var, object* scope, bool assignment, long* address) {
+    object* binding = binding_level(var, scope);
+    bool capture;
+
+    if(binding == NULL)
+        return false;
+    capture = binding != car(scope);
+    if(!keeps_boxes(binding, var, capture, assignment) ||
+       (capture && !can_capture(var, scope, binding))) {
+        *address = UNCAPTURED_ADDRESS;
+        return true;
+    }
+
+    if(capture)
+        note_name(binding, SCOPE_CAPTURED, var);
+    if(assignment)
+        note_name(binding, SCOPE_ASSIGNED, var);
+    if(capture)
+        *address = make_lexical_address(1, capture_slot(var, scope, binding));
+    else
+        *address = make_lexical_address(0, list_index(scope_field(binding, SCOPE_NAMES), var));
+    return true;
+}
+
+/*
+ * Seals a level, boxing the captured variables that may change after
+ * a closure copied them: assigned ones and internal definitions, which
+ * get their value only after the frame is made, or all of them for an
+ * open level. Returns the slots to box as a vector, NULL when there are
+ * none.
+ */
+static object* seal_scope_level(object* level) {
+    object* boxed = the_empty_list;
+    object* slots = the_empty_list;
+    size_t count = 0;
+    size_t slot = 0;
+
+    for(object* names = scope_field(level, SCOPE_NAMES); is_pair(names); names = cdr(names), slot++) {
+        object* var = car(names);
+        if(list_contains(scope_field(level, SCOPE_CAPTURED), var) &&
+           (is_open(level) ||
+            list_contains(scope_field(level, SCOPE_ASSIGNED), var) ||
+            list_contains(scope_field(level, SCOPE_DEFINITIONS), var))) {
+            boxed = cons(var, boxed);
+            slots = cons(make_fixnum((long) slot), slots);
+            count++;
+        }
+    }
+    scope_field(level, SCOPE_BOXED) = boxed;
+    return count == 0 ? NULL : list_to_vector(slots, count);
+}
+
+/* whether var, which the closures around it did not capture, can be
+ * looked up by name instead; the names are then searched from now on */
+static bool found_by_name(object* scope) {
+    if(!reaches_by_name(scope))
+        return false;
+    frames_extended = true;
+    return true;
+}
+
+static object* uncaptured_variable(object* var) {
+    char message[256];
+
+    snprintf(message, sizeof(message),
+             "cannot capture %s in a macro use expanded at run time",
+             var->data.symbol.value);
+    return make_node(NODE_ERROR, execute_error, make_string(message), NULL, NULL);
+}
+
+/* the parameters of a lambda as a proper list of names */
+static object* parameter_names(object* parameters) {
+    object* head = the_empty_list;
+    object* tail = the_empty_list;
+
+    while(!is_empty_list(parameters)) {
+        object* name = is_pair(parameters) ? car(parameters) : parameters;
+        object* cell = cons(name, the_empty_list);
+        if(is_empty_list(head))
+            head = cell;
+        else
+            set_cdr(tail, cell);
+        tail = cell;
+        parameters = is_pair(parameters) ? cdr(parameters) : the_empty_list;
+    }
+    return head;
+}
+
+/*
+ * Collects the names defined at the top of a body, as in SICP 4.1.6,
+ * and in the branches of the conditionals there. A closure cannot see
+ * names added to the frame of the procedure around it at run time, so
+ * they need a slot as well.
+ */
+static object* scan_definitions(object* body, object* names, object* known) {
+    for(; is_pair(body); body = cdr(body)) {
+        object* exp = car(body);
+        object* name = NULL;
+
+        if(is_definition(exp) && is_pair(cdr(exp)))
+            name = definition_variable(exp);
+        else if(is_define_syntax(exp) && is_pair(cdr(exp)))
+            name = cadr(exp);
+        else if(is_begin(exp))
+            names = scan_definitions(begin_actions(exp), names, known);
+        else if(is_if(exp) || is_and(exp) || is_or(exp))
+            names = scan_definitions(cdr(exp), names, known);
+        else if(is_cond(exp)) {
+            for(object* clauses = cond_clauses(exp); is_pair(clauses); clauses = cdr(clauses))
+                if(is_pair(car(clauses)))
+                    names = scan_definitions(cdar(clauses), names, known);
+        }
+
+        if(name != NULL && is_symbol(name) &&
+           !list_contains(names, name) && !list_contains(known, name))
+            names = cons(name, names);
+    }
+    return names;
+}
+
+/* the layout of the third slot of a lambda node */
+#define LAMBDA_VARIABLES  0  /* vector of slot names */
+#define LAMBDA_BOXED      1  /* vector of the slots to box, or NULL */
+#define LAMBDA_CAPTURES   2  /* vector of the names of the closure frame */
+#define LAMBDA_ADDRESSES  3  /* where they are found when the closure is made */
+#define LAMBDA_OPEN       4  /* #t when the closure keeps the whole environment */
+#define LAMBDA_LAYOUT_SIZE 5
+
+static object* analyze_lambda(object* exp, object* scope) {
+    object* parameters = lambda_parameters(exp);
+    object* names = parameter_names(parameters);
+    object* definitions = scan_definitions(lambda_body(exp), the_empty_list, names);
+    /* the arguments fill the first slots, the definitions the rest */
+    object* frame = append_names(names, definitions);
+    object* level = make_scope_level(frame, definitions);
+    object* body = analyze_sequence(lambda_body(exp), cons(level, scope));
+    object* captures = scope_field(level, SCOPE_CAPTURES);
+    size_t count = list_length(captures);
+    object* layout = make_vector(LAMBDA_LAYOUT_SIZE, the_empty_list);
+    object** fields = layout->data.vector.elements;
+
+    fields[LAMBDA_VARIABLES] = list_to_vector(frame, list_length(frame));
+    fields[LAMBDA_BOXED] = seal_scope_level(level);
+    fields[LAMBDA_CAPTURES] = list_to_vector(captures, count);
+    fields[LAMBDA_ADDRESSES] = make_vector(count, the_empty_list);
+    fields[LAMBDA_OPEN] = scope_field(level, SCOPE_OPEN);
+    /* already captured by the enclosing level, if it is not its own */
+    for(size_t i = 0; i < count; i++, captures = cdr(captures)) {
+        long address;
+        resolve_variable(car(captures), scope, false, &address);
+        fields[LAMBDA_ADDRESSES]->data.vector.elements[i] = make_fixnum(address);
+    }
+    return make_node(NODE_LAMBDA, execute_lambda, parameters, body, layout);
+}
+
+object* make_closure(object* lambda, object* env) {
+    object** fields = lambda->data.node.third->data.vector.elements;
+    object* captured = capture_variables(fields[LAMBDA_CAPTURES], fields[LAMBDA_ADDRESSES],
+                                         fields[LAMBDA_OPEN] != false_obj, env);
+
+    return make_procedure(lambda->data.node.first, fields[LAMBDA_VARIABLES], fields[LAMBDA_BOXED],
+                          lambda->data.node.second, captured);
+}
+
+static object* analyze_variable(object* var, object* scope) {
+    long address;
+
+    if(!resolve_variable(var, scope, false, &address) ||
+       (address == UNCAPTURED_ADDRESS && found_by_name(scope)))
+        return make_node(NODE_VARIABLE, execute_variable, var, NULL, NULL);
+    if(address == UNCAPTURED_ADDRESS)
+        return uncaptured_variable(var);
+    return make_node(NODE_LOCAL_VARIABLE, execute_local_variable,
+                     var, NULL, make_fixnum(address));
+}
+
+static object* analyze_assignment(object* exp, object* scope) {
+    object* var = assignment_varialbe(exp);
+    object* value = analyze_in_scope(assignment_value(exp), scope);
+    long address;
+
+    if(!resolve_variable(var, scope, true, &address) ||
+       (address == UNCAPTURED_ADDRESS && found_by_name(scope)))
+        return make_node(NODE_ASSIGNMENT, execute_assignment, var, value, NULL);
+    if(address == UNCAPTURED_ADDRESS)
+        return uncaptured_variable(var);
+    return make_node(NODE_LOCAL_ASSIGNMENT, execute_local_assignment,
+                     var, value, make_fixnum(address));
+}
+
+static object* analyze_definition(object* exp, object* scope) {
+    object* var = definition_variable(exp);
+    object* value = analyze_in_scope(definition_value(exp), scope);
+    long address;
+
+    /* definitions found by scan_definitions have a slot in the frame,
+     * defining a parameter again assigns it */
+    if(is_pair(scope) && binding_level(var, scope) == car(scope)) {
+        resolve_variable(var, scope,
+                         !list_contains(scope_field(car(scope), SCOPE_DEFINITIONS), var),
+                         &address);
+        if(address == UNCAPTURED_ADDRESS)
+            return uncaptured_variable(var);
+        return make_node(NODE_LOCAL_DEFINITION, execute_local_definition,
+                         var, value, make_fixnum(address));
+    }
+    /* closures made from now on must see the names it adds, see
+     * capture_variables */
+    if(is_pair(scope))
+        frames_extended = true;
+    return make_node(NODE_DEFINITION, execute_definition, var, value, NULL);
+}
+
+/* the macro a form's operator names at the top level, if any */
+static object* top_level_macro(object* operator_exp, object* scope) {
+    object* value;
+
+    if(!is_symbol(operator_exp) || binding_level(operator_exp, scope) != NULL)
+        return NULL;
+    value = top_level_value(operator_exp);
+    return value != NULL && is_macro(value) ? value : NULL;
+}
+
+/*
+ * A use of a macro that is already defined when the form is analyzed is
+ * expanded and analyzed right away, and its operands, which need not be
+ * expressions, are left alone. The node still looks at the operator
+ * when it runs, so a redefinition is noticed like for any other use.
+ */
+static object* analyze_application(object* exp, object* scope) {
+    object* macro = top_level_macro(operator(exp), scope);
+    object* expansion = NULL;
+    object* node;
+
+    if(macro != NULL)
+        expansion = try_expand_macro_application(macro, exp);
+    /* may use a macro that is not defined yet, see SCOPE_OPEN */
+    if(is_symbol(operator(exp)) && binding_level(operator(exp), scope) == NULL &&
+       top_level_value(operator(exp)) == NULL)
+        open_scope(scope);
+    if(expansion == NULL)
+        return make_node(NODE_APPLICATION, execute_application,
+                         analyze_in_scope(operator(exp), scope),
+                         analyze_list(operands(exp), scope),
+                         cons(exp, scope));
+
+    node = make_node(NODE_APPLICATION, execute_application,
+                     analyze_variable(operator(exp), scope), NULL, cons(exp, scope));
+    node->data.node.expansion = cons(macro, analyze_in_scope(expansion, scope));
+    return node;
+}
+
+object* application_operands(object* node) {
+    object* form = node->data.node.third;
+
+    if(node->data.node.second == NULL) {
+        node->data.node.second = analyze_list(operands(car(form)), cdr(form));
+        gc_write_barrier(node, node->data.node.second);
+    }
+    return node->data.node.second;
+}
+
+object* analyze(object* exp) {
+    return analyze_in_scope(exp, the_empty_list);
+}
+
+object* analyze_in_scope(object* exp, object* scope) {
+    if(is_self_evaluating(exp))
+        return make_node(NODE_CONSTANT, execute_constant, exp, NULL, NULL);
+    if(is_variable(exp))
+        return analyze_variable(exp, scope);
+    if(is_quoted(exp))
+        return make_node(NODE_CONSTANT, execute_constant, text_of_quotation(exp), NULL, NULL);
+    if(is_quasiquote(exp))
+        return make_node(NODE_QUASIQUOTE, execute_quasiquote,
+                         analyze_quasiquote(cadr(exp), 1, scope), NULL, NULL);
+    if(is_assignment(exp))
+        return analyze_assignment(exp, scope);
+    if(is_definition(exp))
+        return analyze_definition(exp, scope);
+    if(is_define_syntax(exp))
+        return make_node(NODE_DEFINE_SYNTAX, execute_define_syntax, exp, NULL, NULL);
+    if(is_if(exp))
+        return make_node(NODE_IF, execute_if,
+                         analyze_in_scope(if_predicate(exp), scope),
+                         analyze_in_scope(if_consequent(exp), scope),
+                         analyze_in_scope(if_alternative(exp), scope));
+    if(is_lambda(exp))
+        return analyze_lambda(exp, scope);
+    if(is_begin(exp))
+        return analyze_sequence(begin_actions(exp), scope);
+    if(is_cond(exp))
+        return analyze_in_scope(cond_to_if(exp), scope);
+    if(is_let(exp))
+        return analyze_in_scope(let_to_application(exp), scope);
+    if(is_let_star(exp))
+        return analyze_in_scope(let_star_to_nested_lets(exp), scope);
+    if(is_letrec(exp))
+        return analyze_in_scope(letrec_to_let(exp), scope);
+    if(is_and(exp)) {
+        if(is_empty_list(and_tests(exp)))
+            return make_node(NODE_CONSTANT, execute_constant, true_obj, NULL, NULL);
+        return make_node(NODE_AND, execute_and, analyze_list(and_tests(exp), scope), NULL, NULL);
+    }
+    if(is_or(exp)) {
+        if(is_empty_list(or_tests(exp)))
+            return make_node(NODE_CONSTANT, execute_constant, false_obj, NULL, NULL);
+        return make_node(NODE_OR, execute_or, analyze_list(or_tests(exp), scope), NULL, NULL);
+    }
+    if(is_application(exp))
+        return analyze_application(exp, scope);
+
+    /* reported when the node runs, like any other runtime error */
+    return make_node(NODE_INVALID, execute_invalid, exp, NULL, NULL);
+}
+
+/* analyzes every expression of a list into a vector of nodes */
+static object* analyze_list(object* exps, object* scope) {
+    size_t length = 0;
+    object* nodes;
+
+    for(object* iter = exps; is_pair(iter); iter = cdr(iter))
+        length++;
+
+    nodes = make_vector(length, the_empty_list);
+    for(size_t i = 0; i < length; i++) {
+        nodes->data.vector.elements[i] = analyze_in_scope(first_exp(exps), scope);
+        exps = rest_exp(exps);
+    }
+    return nodes;
+}
+
+static object* analyze_sequence(object* exps, object* scope) {
+    if(!is_pair(exps))
+        return make_node(NODE_INVALID, execute_invalid, exps, NULL, NULL);
+    if(is_last_exp(exps))
+        return analyze_in_scope(first_exp(exps), scope);
+    return make_node(NODE_SEQUENCE, execute_sequence, analyze_list(exps, scope), NULL, NULL);
+}
+
+/*
+ * Copies a quasiquote template, replacing the expression of every
+ * unquote and unquote-splicing at depth 1 with its analyzed node, so
+ * that eval_quasiquote only has to execute them.
+ */
+static object* analyze_quasiquote(object* exp, int depth, object* scope) {
+    object* head = the_empty_list;
+    object* tail = the_empty_list;
+
+    if(is_vector(exp)) {
+        object* elements = analyze_quasiquote(vector_to_list(exp), depth, scope);
+        return list_to_vector(elements, exp->data.vector.length);
+    }
+    if(!is_pair(exp))
+        return exp;
+
+    if(is_tagged_list(exp, unquote_symbol) || is_tagged_list(exp, unquote_splicing_symbol)) {
+        object* operand = depth == 1 ?
+                          analyze_in_scope(cadr(exp), scope) :
+                          analyze_quasiquote(cadr(exp), depth - 1, scope);
+        return cons(car(exp), cons(operand, cddr(exp)));
+    }
+    if(is_tagged_list(exp, quasiquote_symbol))
+        return cons(car(exp), cons(analyze_quasiquote(cadr(exp), depth + 1, scope), cddr(exp)));
+
+    while(is_pair(exp)) {
+        object* cell = cons(analyze_quasiquote(car(exp), depth, scope), the_empty_list);
+        if(is_empty_list(head))
+            head = cell;
+        else
+            set_cdr(tail, cell);
+        tail = cell;
+        exp = cdr(exp);
+    }
+    set_cdr(tail, analyze_quasiquote(exp, depth, scope));
+    return head;
+}
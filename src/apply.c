@@ -9,18 +9,20 @@
 #include "header/apply.h"
 #include "header/environment.h"
 #include "header/eval.h"
+#include "header/analyze.h"
 #include "header/builtin.h"
 #include "header/error.h"
+#include "header/vm.h"
 
 object* apply(object* procedure, object* arguments) {
+    if(vm_enabled)
+        return vm_apply(procedure, arguments);
     if(is_primitive_proc(procedure)) {
-        return (procedure->data.primitive_proc.fun)(arguments);
+        return apply_primitive_procedure(procedure, arguments);
     }
     else if(is_compound_proc(procedure)) {
-        object* environ = extend_environment(procedure->data.compound_proc.parameters,
-                                             arguments,
-                                             procedure->data.compound_proc.env);
-        return eval_sequence(procedure->data.compound_proc.body, environ);
+        object* environ = extend_procedure_environment(procedure, arguments);
+        return execute(procedure->data.compound_proc.body, environ);
     }
     else {
         error_handle_with_object(stderr,
@@ -15,20 +15,11 @@
 #include "header/eval.h"
 #include "header/apply.h"
 #include "header/write.h"
+#include "header/gc.h"
+#include "header/vm.h"
 
 void init_built_in() {
-    true_obj = alloc_object(); /* init true_obj */
-    true_obj->type = BOOLEAN;
-    true_obj->data.boolean.value = true;
-
-    false_obj = alloc_object(); /* init false_obj */
-    false_obj->type = BOOLEAN;
-    false_obj->data.boolean.value = false;
-
-    the_empty_list = alloc_object(); /* init the_empty_list */
-    the_empty_list->type = THE_EMPTY_LIST;
-    symbol_table = the_empty_list;
-
+    /* true_obj, false_obj and the_empty_list are immediates, see object.h */
     quote_symbol  = make_symbol("quote" );
     quasiquote_symbol = make_symbol("quasiquote");
     unquote_symbol = make_symbol("unquote");
@@ -54,7 +45,7 @@ void init_built_in() {
 
     the_empty_environment = the_empty_list;
     the_global_environment = make_environment();
-
+    vm_init();
 }
 
 object* make_environment() {
@@ -69,23 +60,63 @@ object* setup_environment() {
     return env;
 }
 
-object* make_compound_procedure(object* parameters, object* body, object* env) {
-    object* obj = alloc_object();
+object* make_compound_procedure(object* parameters, object* variables, object* boxed,
+                                object* body, object* env) {
+    object* obj = alloc_object(COMPOUND_PROC);
 
-    obj->type = COMPOUND_PROC;
     obj->data.compound_proc.parameters = parameters;
+    obj->data.compound_proc.variables = variables;
+    obj->data.compound_proc.boxed      = boxed;
     obj->data.compound_proc.body       = body;
     obj->data.compound_proc.env        = env;
     return obj;
 }
 
 object* make_primitive_procedure(object* (* fun)(object* )) {
-    object* obj = alloc_object();
-    obj->type = PRIMITIVE_PROC;
+    object* obj = alloc_object(PRIMITIVE_PROC);
     obj->data.primitive_proc.fun = fun;
+    obj->data.primitive_proc.argv_fun = NULL;
+    obj->data.primitive_proc.binary_fun = NULL;
+    obj->data.primitive_proc.name = NULL;
+    obj->data.primitive_proc.min_args = 0;
+    obj->data.primitive_proc.max_args = PRIMITIVE_VARIADIC;
+    return obj;
+}
+
+object* make_argv_primitive_procedure(const char* name, size_t min_args, size_t max_args,
+                                      object* (* argv_fun)(size_t argc, object** argv),
+                                      object* (* binary_fun)(object* first, object* second)) {
+    object* obj = alloc_object(PRIMITIVE_PROC);
+    obj->data.primitive_proc.fun = NULL;
+    obj->data.primitive_proc.argv_fun = argv_fun;
+    obj->data.primitive_proc.binary_fun = binary_fun;
+    obj->data.primitive_proc.name = name;
+    obj->data.primitive_proc.min_args = min_args;
+    obj->data.primitive_proc.max_args = max_args;
     return obj;
 }
 
+object* apply_primitive_procedure(object* procedure, object* arguments) {
+    object* inline_argv[PRIMITIVE_ARGV_INLINE];
+    object** argv = inline_argv;
+    size_t argc = 0;
+
+    if(procedure->data.primitive_proc.argv_fun == NULL)
+        return (procedure->data.primitive_proc.fun)(arguments);
+
+    for(object* iter = arguments; is_pair(iter); iter = cdr(iter))
+        argc++;
+    if(!primitive_arity_ok(procedure, argc))
+        primitive_arity_error(procedure, argc);
+    if(argc == 2 && procedure->data.primitive_proc.binary_fun != NULL)
+        return (procedure->data.primitive_proc.binary_fun)(car(arguments), cadr(arguments));
+    if(argc > PRIMITIVE_ARGV_INLINE)
+        argv = make_vector(argc, the_empty_list)->data.vector.elements;
+    for(size_t i = 0; i < argc; i++, arguments = cdr(arguments))
+        argv[i] = car(arguments);
+    return (procedure->data.primitive_proc.argv_fun)(argc, argv);
+}
+
 static void primitive_error(const char* proc_name, const char* message) {
     char error_buf[256];
     snprintf(error_buf, sizeof(error_buf), "%s: %s", proc_name, message);
@@ -119,6 +150,21 @@ static void require_min_args(const char* proc_name, object* arguments, int minim
     }
 }
 
+void primitive_arity_error(object* procedure, size_t argc) {
+    size_t min_args = procedure->data.primitive_proc.min_args;
+    size_t max_args = procedure->data.primitive_proc.max_args;
+    char error_buf[128];
+
+    if(max_args == PRIMITIVE_VARIADIC)
+        snprintf(error_buf, sizeof(error_buf), "expected at least %zu args, got %zu", min_args, argc);
+    else if(min_args == max_args)
+        snprintf(error_buf, sizeof(error_buf), "expected %zu args, got %zu", min_args, argc);
+    else
+        snprintf(error_buf, sizeof(error_buf), "expected %zu to %zu args, got %zu",
+                 min_args, max_args, argc);
+    primitive_error(procedure->data.primitive_proc.name, error_buf);
+}
+
 static void require_fixnum_arg(const char* proc_name, object* arg, int index) {
     if(!is_fixnum(arg)) {
         char error_buf[128];
@@ -163,65 +209,6 @@ static void require_output_port_arg(const char* proc_name, object* arg, int inde
         primitive_error(proc_name, "output port is closed or invalid");
 }
 
-static bool is_datum_equal(object* first, object* second) {
-    if(first == second)
-        return true;
-    if(first->type != second->type)
-        return false;
-
-    switch(first->type) {
-        case FIXNUM:
-            return first->data.fixnum.value == second->data.fixnum.value;
-        case BOOLEAN:
-            return first->data.boolean.value == second->data.boolean.value;
-        case CHARACTER:
-            return first->data.character.value == second->data.character.value;
-        case STRING:
-            return strcmp(first->data.string.value, second->data.string.value) == 0;
-        case SYMBOL:
-            return first == second;
-        case THE_EMPTY_LIST:
-            return true;
-        case PAIR:
-            return is_datum_equal(car(first), car(second)) &&
-                   is_datum_equal(cdr(first), cdr(second));
-        case VECTOR: {
-            object* left = first->data.vector.elements;
-            object* right = second->data.vector.elements;
-            if(first->data.vector.length != second->data.vector.length)
-                return false;
-            while(is_pair(left) && is_pair(right)) {
-                if(!is_datum_equal(car(left), car(right)))
-                    return false;
-                left = cdr(left);
-                right = cdr(right);
-            }
-            return is_empty_list(left) && is_empty_list(right);
-        }
-        default:
-            return first == second;
-    }
-}
-
-static object* copy_list(object* list) {
-    object* head = the_empty_list;
-    object* tail = the_empty_list;
-
-    while(is_pair(list)) {
-        object* cell = cons(car(list), the_empty_list);
-        if(is_empty_list(head))
-            head = cell;
-        else
-            set_cdr(tail, cell);
-        tail = cell;
-        list = cdr(list);
-    }
-
-    if(!is_empty_list(list))
-        primitive_error("list-copy", "expected proper list");
-    return head;
-}
-
 static size_t proper_list_length(object* list, const char* proc_name) {
     size_t length = 0;
     while(is_pair(list)) {
@@ -233,16 +220,47 @@ static size_t proper_list_length(object* list, const char* proc_name) {
     return length;
 }
 
-static object* vector_ref_cell(object* vector, long index, const char* proc_name) {
-    object* cursor;
+static void require_vector_arg(const char* proc_name, object* arg, int index) {
+    if(!is_vector(arg)) {
+        char error_buf[128];
+        snprintf(error_buf, sizeof(error_buf), "arg %d must be vector", index);
+        primitive_error(proc_name, error_buf);
+    }
+}
+
+static size_t require_length_arg(const char* proc_name, object* arg, int index) {
+    require_fixnum_arg(proc_name, arg, index);
+    if(fixnum_value(arg) < 0) {
+        char error_buf[128];
+        snprintf(error_buf, sizeof(error_buf), "arg %d must be non-negative", index);
+        primitive_error(proc_name, error_buf);
+    }
+    return (size_t) fixnum_value(arg);
+}
 
+static object** vector_ref_cell(object* vector, long index, const char* proc_name) {
     if(index < 0 || (size_t)index >= vector->data.vector.length)
         primitive_error(proc_name, "index out of bounds");
+    return &vector->data.vector.elements[index];
+}
 
-    cursor = vector->data.vector.elements;
-    while(index-- > 0)
-        cursor = cdr(cursor);
-    return cursor;
+/* reads the optional [start [end]] arguments of the bulk vector operations */
+static void vector_range_args(const char* proc_name, object* vector, object* rest,
+                              int index, size_t* start, size_t* end) {
+    *start = 0;
+    *end = vector->data.vector.length;
+    if(is_pair(rest)) {
+        *start = require_length_arg(proc_name, car(rest), index);
+        rest = cdr(rest);
+    }
+    if(is_pair(rest)) {
+        *end = require_length_arg(proc_name, car(rest), index + 1);
+        rest = cdr(rest);
+    }
+    if(!is_empty_list(rest))
+        primitive_error(proc_name, "too many args");
+    if(*start > *end || *end > vector->data.vector.length)
+        primitive_error(proc_name, "invalid start/end range");
 }
 
 static object* eval_source_file(FILE* source_file, object* env) {
@@ -263,7 +281,7 @@ static object* eval_source_file(FILE* source_file, object* env) {
     list = gen_token_list(tokens);
     while(list->token_pointer != NULL) {
         eval(parse(list), env);
-        gc_collect();
+        gc_safepoint();
     }
 
     destroy_token_list(list);
@@ -271,140 +289,173 @@ static object* eval_source_file(FILE* source_file, object* env) {
 }
 
 /* implement of built-in procedures */
-static object* add_procedure(object* arguments) {
-    int index = 1;
+static object* add_procedure(size_t argc, object** argv) {
     long result = 0;
-    while(!is_empty_list(arguments)) {
-        require_fixnum_arg("+", car(arguments), index++);
-        result += (car(arguments)->data.fixnum.value);
-        arguments = cdr(arguments);
+    for(size_t i = 0; i < argc; i++) {
+        require_fixnum_arg("+", argv[i], (int) i + 1);
+        result += fixnum_value(argv[i]);
     }
     return make_fixnum(result);
 }
 
-static object* sub_procedure(object* arguments) {
-    int index = 2;
-    require_min_args("-", arguments, 1);
-    require_fixnum_arg("-", car(arguments), 1);
-    long result = car(arguments)->data.fixnum.value;
-    arguments = cdr(arguments);
+static object* sub_procedure(size_t argc, object** argv) {
+    long result;
 
-    while(!is_empty_list(arguments)) {
-        require_fixnum_arg("-", car(arguments), index++);
-        result -= car(arguments)->data.fixnum.value;
-        arguments = cdr(arguments);
+    require_fixnum_arg("-", argv[0], 1);
+    result = fixnum_value(argv[0]);
+    for(size_t i = 1; i < argc; i++) {
+        require_fixnum_arg("-", argv[i], (int) i + 1);
+        result -= fixnum_value(argv[i]);
     }
     return make_fixnum(result);
 }
 
-static object* mul_procedure(object* arguments) {
-    int index = 1;
+static object* mul_procedure(size_t argc, object** argv) {
     long result = 1;
-
-    while(!is_empty_list(arguments)) {
-        require_fixnum_arg("*", car(arguments), index++);
-        result *= car(arguments)->data.fixnum.value;
-        arguments = cdr(arguments);
+    for(size_t i = 0; i < argc; i++) {
+        require_fixnum_arg("*", argv[i], (int) i + 1);
+        result *= fixnum_value(argv[i]);
     }
-
     return make_fixnum(result);
 }
 
-static object* div_procedure(object* arguments) {
+static object* div_procedure(size_t argc, object** argv) {
     long dividend;
     long divisor;
 
-    require_exact_args("/", arguments, 2);
-    require_fixnum_arg("/", car(arguments), 1);
-    require_fixnum_arg("/", cadr(arguments), 2);
+    (void) argc;
+    require_fixnum_arg("/", argv[0], 1);
+    require_fixnum_arg("/", argv[1], 2);
 
-    dividend = car(arguments)->data.fixnum.value;
-    divisor = cadr(arguments)->data.fixnum.value;
+    dividend = fixnum_value(argv[0]);
+    divisor = fixnum_value(argv[1]);
     if(divisor == 0)
         primitive_error("/", "division by zero");
 
     return make_fixnum(dividend / divisor);
 }
 
-static object* remainder_procedure(object* arguments) {
+static object* remainder_procedure(size_t argc, object** argv) {
     long dividend;
     long divisor;
 
-    require_exact_args("remainder", arguments, 2);
-    require_fixnum_arg("remainder", car(arguments), 1);
-    require_fixnum_arg("remainder", cadr(arguments), 2);
+    (void) argc;
+    require_fixnum_arg("remainder", argv[0], 1);
+    require_fixnum_arg("remainder", argv[1], 2);
 
-    dividend = car(arguments)->data.fixnum.value;
-    divisor = cadr(arguments)->data.fixnum.value;
+    dividend = fixnum_value(argv[0]);
+    divisor = fixnum_value(argv[1]);
     if(divisor == 0)
         primitive_error("remainder", "division by zero");
 
     return make_fixnum(dividend % divisor);
 }
 
-static object* is_num_equal_procedure(object* arguments) {
-    int index = 2;
-    require_min_args("=", arguments, 2);
-    require_fixnum_arg("=", car(arguments), 1);
-    long value = car(arguments)->data.fixnum.value;
+static object* is_num_equal_procedure(size_t argc, object** argv) {
+    long value;
 
-    while(!is_empty_list(arguments = cdr(arguments))) {
-        require_fixnum_arg("=", car(arguments), index++);
-        if(value != car(arguments)->data.fixnum.value)
+    require_fixnum_arg("=", argv[0], 1);
+    value = fixnum_value(argv[0]);
+    for(size_t i = 1; i < argc; i++) {
+        require_fixnum_arg("=", argv[i], (int) i + 1);
+        if(value != fixnum_value(argv[i]))
             return false_obj;
     }
     return true_obj;
 }
 
-static object* is_less_procedure(object* arguments) {
-    int index = 2;
-    require_min_args("<", arguments, 2);
-    require_fixnum_arg("<", car(arguments), 1);
-    long previous = car(arguments)->data.fixnum.value;
-    long next;
-
-    while(!is_empty_list(arguments = cdr(arguments))) {
-        require_fixnum_arg("<", car(arguments), index++);
-        next = car(arguments)->data.fixnum.value;
-        if(previous >= next)
+static object* is_less_procedure(size_t argc, object** argv) {
+    require_fixnum_arg("<", argv[0], 1);
+    for(size_t i = 1; i < argc; i++) {
+        require_fixnum_arg("<", argv[i], (int) i + 1);
+        if(fixnum_value(argv[i - 1]) >= fixnum_value(argv[i]))
             return false_obj;
-        previous = next;
     }
     return true_obj;
 }
 
-static object* is_greater_procedure(object* arguments) {
-    int index = 2;
-    require_min_args(">", arguments, 2);
-    require_fixnum_arg(">", car(arguments), 1);
-    long previous = car(arguments)->data.fixnum.value;
-    long next;
-
-    while(!is_empty_list(arguments = cdr(arguments))) {
-        require_fixnum_arg(">", car(arguments), index++);
-        next = car(arguments)->data.fixnum.value;
-        if(previous <= next)
+static object* is_greater_procedure(size_t argc, object** argv) {
+    require_fixnum_arg(">", argv[0], 1);
+    for(size_t i = 1; i < argc; i++) {
+        require_fixnum_arg(">", argv[i], (int) i + 1);
+        if(fixnum_value(argv[i - 1]) <= fixnum_value(argv[i]))
             return false_obj;
-        previous = next;
     }
     return true_obj;
 }
 
-static object* cons_procedure(object* arguments) {
-    require_exact_args("cons", arguments, 2);
-    return cons(car(arguments), cadr(arguments));
+/*
+ * Two argument entry points of the arithmetic and comparisons. Fixnum
+ * immediates are handled inline, anything else goes through the general
+ * procedure so errors read the same.
+ */
+static object* add2_procedure(object* first, object* second) {
+    object* argv[2] = {first, second};
+
+    if(are_fixnum_immediates(first, second))
+        return make_fixnum(fixnum_immediate_value(first) + fixnum_immediate_value(second));
+    return add_procedure(2, argv);
+}
+
+static object* sub2_procedure(object* first, object* second) {
+    object* argv[2] = {first, second};
+
+    if(are_fixnum_immediates(first, second))
+        return make_fixnum(fixnum_immediate_value(first) - fixnum_immediate_value(second));
+    return sub_procedure(2, argv);
+}
+
+static object* mul2_procedure(object* first, object* second) {
+    object* argv[2] = {first, second};
+
+    if(are_fixnum_immediates(first, second))
+        return make_fixnum(fixnum_immediate_value(first) * fixnum_immediate_value(second));
+    return mul_procedure(2, argv);
+}
+
+static object* is_num_equal2_procedure(object* first, object* second) {
+    object* argv[2] = {first, second};
+
+    if(are_fixnum_immediates(first, second))
+        return first == second ? true_obj : false_obj;
+    return is_num_equal_procedure(2, argv);
 }
 
-static object* car_procedure(object* arguments) {
-    require_exact_args("car", arguments, 1);
-    require_pair_arg("car", car(arguments), 1);
-    return caar(arguments);
+static object* is_less2_procedure(object* first, object* second) {
+    object* argv[2] = {first, second};
+
+    if(are_fixnum_immediates(first, second))
+        return fixnum_immediate_value(first) < fixnum_immediate_value(second) ? true_obj : false_obj;
+    return is_less_procedure(2, argv);
 }
 
-static object* cdr_procedure(object* arguments) {
-    require_exact_args("cdr", arguments, 1);
-    require_pair_arg("cdr", car(arguments), 1);
-    return cdar(arguments);
+static object* is_greater2_procedure(object* first, object* second) {
+    object* argv[2] = {first, second};
+
+    if(are_fixnum_immediates(first, second))
+        return fixnum_immediate_value(first) > fixnum_immediate_value(second) ? true_obj : false_obj;
+    return is_greater_procedure(2, argv);
+}
+
+static object* cons_procedure(size_t argc, object** argv) {
+    (void) argc;
+    return cons(argv[0], argv[1]);
+}
+
+static object* cons2_procedure(object* first, object* second) {
+    return cons(first, second);
+}
+
+static object* car_procedure(size_t argc, object** argv) {
+    (void) argc;
+    require_pair_arg("car", argv[0], 1);
+    return car(argv[0]);
+}
+
+static object* cdr_procedure(size_t argc, object** argv) {
+    (void) argc;
+    require_pair_arg("cdr", argv[0], 1);
+    return cdr(argv[0]);
 }
 
 static object* set_car_procedure(object* arguments) {
@@ -425,30 +476,37 @@ static object* list_procedure(object* arguments) {
     return arguments;
 }
 
-static object* is_equal_procedure(object* arguments) {
-    require_exact_args("eq?", arguments, 2);
-    object* first = car(arguments);
-    object* second = cadr(arguments);
+static object* is_equal_procedure(size_t argc, object** argv) {
+    object* first = argv[0];
+    object* second = argv[1];
 
-    if(first->type != second->type)
+    (void) argc;
+    if(type_of(first) != type_of(second))
         return false_obj;
 
-    switch(first->type) {
+    switch(type_of(first)) {
         case FIXNUM:
-            return first->data.fixnum.value == second->data.fixnum.value ?
+            return fixnum_value(first) == fixnum_value(second) ?
                     true_obj : false_obj;
 
         case STRING:
-            return strcmp(first->data.string.value, second->data.string.value) == 0 ?
-                    true_obj : false_obj;
+            return string_equal(first, second) ? true_obj : false_obj;
         default:
             return first == second ? true_obj : false_obj;
     }
 }
 
-static object* is_null_procedure(object* arguments) {
-    require_exact_args("null?", arguments, 1);
-    return is_empty_list(car(arguments)) ? true_obj : false_obj;
+static object* is_equal2_procedure(object* first, object* second) {
+    object* argv[2] = {first, second};
+
+    if(first == second)
+        return true_obj;
+    return is_equal_procedure(2, argv);
+}
+
+static object* is_null_procedure(size_t argc, object** argv) {
+    (void) argc;
+    return is_empty_list(argv[0]) ? true_obj : false_obj;
 }
 
 static object* is_bool_procedure(object* arguments) {
@@ -471,9 +529,9 @@ static object* is_string_procedure(object* arguments) {
     return is_string(car(arguments)) ? true_obj : false_obj;
 }
 
-static object* is_pair_procedure(object* arguments) {
-    require_exact_args("pair?", arguments, 1);
-    return is_pair(car(arguments)) ? true_obj : false_obj;
+static object* is_pair_procedure(size_t argc, object** argv) {
+    (void) argc;
+    return is_pair(argv[0]) ? true_obj : false_obj;
 }
 
 static object* is_procedure_procedure(object* arguments) {
@@ -487,7 +545,7 @@ static object* number_to_string_procedure(object* arguments) {
 
     require_exact_args("number->string", arguments, 1);
     require_fixnum_arg("number->string", car(arguments), 1);
-    sprintf(buffer, "%ld", car(arguments)->data.fixnum.value);
+    sprintf(buffer, "%ld", fixnum_value(car(arguments)));
     return make_string(buffer);
 }
 
@@ -507,6 +565,9 @@ static object* symbol_to_string_procedure(object* arguments) {
 static object* string_to_symbol_procedure(object* arguments) {
     require_exact_args("string->symbol", arguments, 1);
     require_string_arg("string->symbol", car(arguments), 1);
+    /* symbols are interned by their C string */
+    if(memchr(car(arguments)->data.string.value, '\0', car(arguments)->data.string.length) != NULL)
+        primitive_error("string->symbol", "arg 1 must not contain NUL");
     return make_symbol(car(arguments)->data.string.value);
 }
 
@@ -514,37 +575,117 @@ static object* string_length_procedure(object* arguments) {
     size_t len;
     require_exact_args("string-length", arguments, 1);
     require_string_arg("string-length", car(arguments), 1);
-    len = strlen(car(arguments)->data.string.value);
+    len = car(arguments)->data.string.length;
     if(len > (size_t)LONG_MAX)
         primitive_error("string-length", "result out of range");
     return make_fixnum((long)len);
 }
 
-static object* string_ref_procedure(object* arguments) {
+static object* make_string_procedure(object* arguments) {
+    long length;
+    char fill = ' ';
+    object* result;
+
+    require_min_args("make-string", arguments, 1);
+    require_fixnum_arg("make-string", car(arguments), 1);
+    length = fixnum_value(car(arguments));
+    if(length < 0)
+        primitive_error("make-string", "arg 1 must be non-negative");
+    if(is_pair(cdr(arguments))) {
+        require_exact_args("make-string", arguments, 2);
+        if(!is_character(cadr(arguments)))
+            primitive_error("make-string", "arg 2 must be character");
+        fill = character_value(cadr(arguments));
+    }
+
+    result = make_sized_string(NULL, (size_t)length);
+    memset(result->data.string.value, fill, (size_t)length);
+    return result;
+}
+
+static object* string_ref_procedure(size_t argc, object** argv) {
     object* string_obj;
     long index;
     size_t len;
 
-    require_exact_args("string-ref", arguments, 2);
-    string_obj = car(arguments);
+    (void) argc;
+    string_obj = argv[0];
     require_string_arg("string-ref", string_obj, 1);
-    require_fixnum_arg("string-ref", cadr(arguments), 2);
+    require_fixnum_arg("string-ref", argv[1], 2);
 
-    index = cadr(arguments)->data.fixnum.value;
-    len = strlen(string_obj->data.string.value);
+    index = fixnum_value(argv[1]);
+    len = string_obj->data.string.length;
     if(index < 0 || (size_t)index >= len)
         primitive_error("string-ref", "index out of bounds");
     return make_character(string_obj->data.string.value[index]);
 }
 
+static object* string_set_procedure(object* arguments) {
+    object* string_obj;
+    long index;
+
+    require_exact_args("string-set!", arguments, 3);
+    string_obj = car(arguments);
+    require_string_arg("string-set!", string_obj, 1);
+    require_fixnum_arg("string-set!", cadr(arguments), 2);
+    if(!is_character(caddr(arguments)))
+        primitive_error("string-set!", "arg 3 must be character");
+
+    index = fixnum_value(cadr(arguments));
+    if(index < 0 || (size_t)index >= string_obj->data.string.length)
+        primitive_error("string-set!", "index out of bounds");
+    string_obj->data.string.value[index] = character_value(caddr(arguments));
+    return ok_symbol;
+}
+
+/* (string-copy! to at from [start [end]]) */
+static object* string_copy_to_procedure(object* arguments) {
+    object* to;
+    object* from;
+    object* rest;
+    long at;
+    long start = 0;
+    long end;
+
+    require_min_args("string-copy!", arguments, 3);
+    to = car(arguments);
+    from = caddr(arguments);
+    require_string_arg("string-copy!", to, 1);
+    require_fixnum_arg("string-copy!", cadr(arguments), 2);
+    require_string_arg("string-copy!", from, 3);
+    at = fixnum_value(cadr(arguments));
+    end = (long) from->data.string.length;
+
+    rest = cdddr(arguments);
+    if(is_pair(rest)) {
+        require_fixnum_arg("string-copy!", car(rest), 4);
+        start = fixnum_value(car(rest));
+        rest = cdr(rest);
+    }
+    if(is_pair(rest)) {
+        require_fixnum_arg("string-copy!", car(rest), 5);
+        end = fixnum_value(car(rest));
+        rest = cdr(rest);
+    }
+    if(!is_empty_list(rest))
+        primitive_error("string-copy!", "too many args");
+    if(start < 0 || start > end || (size_t)end > from->data.string.length)
+        primitive_error("string-copy!", "invalid start/end range");
+    if(at < 0 || (size_t)at > to->data.string.length ||
+       (size_t)(end - start) > to->data.string.length - (size_t)at)
+        primitive_error("string-copy!", "destination too small");
+
+    /* the ranges may overlap when both strings are the same object */
+    memmove(to->data.string.value + at, from->data.string.value + start,
+            (size_t)(end - start));
+    return ok_symbol;
+}
+
 static object* substring_procedure(object* arguments) {
     object* string_obj;
     long start;
     long end;
     size_t len;
-    size_t slice_len;
-    char* buffer;
-    object* result;
 
     require_exact_args("substring", arguments, 3);
     string_obj = car(arguments);
@@ -552,53 +693,37 @@ static object* substring_procedure(object* arguments) {
     require_fixnum_arg("substring", cadr(arguments), 2);
     require_fixnum_arg("substring", caddr(arguments), 3);
 
-    start = cadr(arguments)->data.fixnum.value;
-    end = caddr(arguments)->data.fixnum.value;
-    len = strlen(string_obj->data.string.value);
+    start = fixnum_value(cadr(arguments));
+    end = fixnum_value(caddr(arguments));
+    len = string_obj->data.string.length;
     if(start < 0 || end < 0 || start > end || (size_t)end > len)
         primitive_error("substring", "invalid start/end range");
 
-    slice_len = (size_t)(end - start);
-    buffer = (char*) malloc(slice_len + 1);
-    if(buffer == NULL)
-        primitive_error("substring", "out of memory");
-    if(slice_len > 0)
-        memcpy(buffer, string_obj->data.string.value + start, slice_len);
-    buffer[slice_len] = '\0';
-    result = make_string(buffer);
-    free(buffer);
-    return result;
+    return make_sized_string(string_obj->data.string.value + start, (size_t)(end - start));
 }
 
 static object* string_append_procedure(object* arguments) {
     size_t total_len = 0;
     object* cursor = arguments;
-    char* buffer;
     char* write_cursor;
     object* result;
     int index = 1;
 
     while(!is_empty_list(cursor)) {
         require_string_arg("string-append", car(cursor), index++);
-        total_len += strlen(car(cursor)->data.string.value);
+        total_len += car(cursor)->data.string.length;
         cursor = cdr(cursor);
     }
 
-    buffer = (char*) malloc(total_len + 1);
-    if(buffer == NULL)
-        primitive_error("string-append", "out of memory");
-    write_cursor = buffer;
+    result = make_sized_string(NULL, total_len);
+    write_cursor = result->data.string.value;
     cursor = arguments;
     while(!is_empty_list(cursor)) {
-        size_t len = strlen(car(cursor)->data.string.value);
+        size_t len = car(cursor)->data.string.length;
         memcpy(write_cursor, car(cursor)->data.string.value, len);
         write_cursor += len;
         cursor = cdr(cursor);
     }
-    *write_cursor = '\0';
-
-    result = make_string(buffer);
-    free(buffer);
     return result;
 }
 
@@ -622,14 +747,26 @@ static object* load_procedure(object* arguments) {
     return ok_symbol;
 }
 
+/* how many collector pauses there were so far */
+static object* gc_pauses_procedure(object* arguments) {
+    require_exact_args("gc-pauses", arguments, 0);
+    return make_fixnum((long) gc_pauses());
+}
+
+/* how many collector pauses took longer than GC_PAUSE_TARGET_MS */
+static object* gc_pauses_over_target_procedure(object* arguments) {
+    require_exact_args("gc-pauses-over-target", arguments, 0);
+    return make_fixnum((long) gc_pauses_over_target());
+}
+
 static object* is_eqv_procedure(object* arguments) {
     require_exact_args("eqv?", arguments, 2);
-    return is_datum_equal(car(arguments), cadr(arguments)) ? true_obj : false_obj;
+    return datum_equal(car(arguments), cadr(arguments)) ? true_obj : false_obj;
 }
 
 static object* is_equal_deep_procedure(object* arguments) {
     require_exact_args("equal?", arguments, 2);
-    return is_datum_equal(car(arguments), cadr(arguments)) ? true_obj : false_obj;
+    return datum_equal(car(arguments), cadr(arguments)) ? true_obj : false_obj;
 }
 
 static object* is_char_procedure(object* arguments) {
@@ -641,14 +778,14 @@ static object* char_to_integer_procedure(object* arguments) {
     require_exact_args("char->integer", arguments, 1);
     if(!is_character(car(arguments)))
         primitive_error("char->integer", "arg 1 must be character");
-    return make_fixnum((unsigned char)car(arguments)->data.character.value);
+    return make_fixnum((unsigned char)character_value(car(arguments)));
 }
 
 static object* integer_to_char_procedure(object* arguments) {
     long value;
     require_exact_args("integer->char", arguments, 1);
     require_fixnum_arg("integer->char", car(arguments), 1);
-    value = car(arguments)->data.fixnum.value;
+    value = fixnum_value(car(arguments));
     if(value < 0 || value > 255)
         primitive_error("integer->char", "codepoint out of range [0,255]");
     return make_character((char)value);
@@ -665,7 +802,20 @@ static object* is_port_procedure(object* arguments) {
 }
 
 static object* vector_procedure(object* arguments) {
-    return make_vector(copy_list(arguments), proper_list_length(arguments, "vector"));
+    return list_to_vector(arguments, proper_list_length(arguments, "vector"));
+}
+
+static object* make_vector_procedure(object* arguments) {
+    size_t length;
+    object* fill = make_fixnum(0);
+
+    require_min_args("make-vector", arguments, 1);
+    length = require_length_arg("make-vector", car(arguments), 1);
+    if(is_pair(cdr(arguments))) {
+        require_exact_args("make-vector", arguments, 2);
+        fill = cadr(arguments);
+    }
+    return make_vector(length, fill);
 }
 
 static object* vector_length_procedure(object* arguments) {
@@ -675,40 +825,97 @@ static object* vector_length_procedure(object* arguments) {
     return make_fixnum((long)car(arguments)->data.vector.length);
 }
 
-static object* vector_ref_procedure(object* arguments) {
+static object* vector_ref_procedure(size_t argc, object** argv) {
     object* vector_obj;
     long index;
 
-    require_exact_args("vector-ref", arguments, 2);
-    vector_obj = car(arguments);
+    (void) argc;
+    vector_obj = argv[0];
     if(!is_vector(vector_obj))
         primitive_error("vector-ref", "arg 1 must be vector");
-    require_fixnum_arg("vector-ref", cadr(arguments), 2);
-    index = cadr(arguments)->data.fixnum.value;
-    return car(vector_ref_cell(vector_obj, index, "vector-ref"));
+    require_fixnum_arg("vector-ref", argv[1], 2);
+    index = fixnum_value(argv[1]);
+    return *vector_ref_cell(vector_obj, index, "vector-ref");
 }
 
 static object* vector_set_procedure(object* arguments) {
     object* vector_obj;
     long index;
-    object* cell;
 
     require_exact_args("vector-set!", arguments, 3);
     vector_obj = car(arguments);
     if(!is_vector(vector_obj))
         primitive_error("vector-set!", "arg 1 must be vector");
     require_fixnum_arg("vector-set!", cadr(arguments), 2);
-    index = cadr(arguments)->data.fixnum.value;
-    cell = vector_ref_cell(vector_obj, index, "vector-set!");
-    set_car(cell, caddr(arguments));
+    index = fixnum_value(cadr(arguments));
+    *vector_ref_cell(vector_obj, index, "vector-set!") = caddr(arguments);
+    gc_write_barrier(vector_obj, caddr(arguments));
     return ok_symbol;
 }
 
+static object* vector_fill_procedure(object* arguments) {
+    object* vector_obj;
+    object* fill;
+    size_t start;
+    size_t end;
+
+    require_min_args("vector-fill!", arguments, 2);
+    vector_obj = car(arguments);
+    require_vector_arg("vector-fill!", vector_obj, 1);
+    fill = cadr(arguments);
+    vector_range_args("vector-fill!", vector_obj, cddr(arguments), 3, &start, &end);
+
+    for(size_t i = start; i < end; i++)
+        vector_obj->data.vector.elements[i] = fill;
+    gc_write_barrier(vector_obj, fill);
+    return ok_symbol;
+}
+
+static object* vector_copy_procedure(object* arguments) {
+    object* vector_obj;
+    object* result;
+    size_t start;
+    size_t end;
+
+    require_min_args("vector-copy", arguments, 1);
+    vector_obj = car(arguments);
+    require_vector_arg("vector-copy", vector_obj, 1);
+    vector_range_args("vector-copy", vector_obj, cdr(arguments), 2, &start, &end);
+
+    result = make_vector(end - start, the_empty_list);
+    if(end > start)
+        memcpy(result->data.vector.elements, vector_obj->data.vector.elements + start,
+               (end - start) * sizeof(object*));
+    return result;
+}
+
+static object* vector_grow_procedure(object* arguments) {
+    object* vector_obj;
+    object* result;
+    size_t length;
+    size_t old_length;
+
+    require_exact_args("vector-grow", arguments, 2);
+    vector_obj = car(arguments);
+    require_vector_arg("vector-grow", vector_obj, 1);
+    length = require_length_arg("vector-grow", cadr(arguments), 2);
+    old_length = vector_obj->data.vector.length;
+    if(length < old_length)
+        primitive_error("vector-grow", "new length is smaller than the vector");
+
+    /* the new slots hold 0, like make-vector without a fill */
+    result = make_vector(length, make_fixnum(0));
+    if(old_length > 0)
+        memcpy(result->data.vector.elements, vector_obj->data.vector.elements,
+               old_length * sizeof(object*));
+    return result;
+}
+
 static object* vector_to_list_procedure(object* arguments) {
     require_exact_args("vector->list", arguments, 1);
     if(!is_vector(car(arguments)))
         primitive_error("vector->list", "arg 1 must be vector");
-    return copy_list(car(arguments)->data.vector.elements);
+    return vector_to_list(car(arguments));
 }
 
 static object* list_to_vector_procedure(object* arguments) {
@@ -717,7 +924,7 @@ static object* list_to_vector_procedure(object* arguments) {
     list_obj = car(arguments);
     if(!is_empty_list(list_obj) && !is_pair(list_obj))
         primitive_error("list->vector", "arg 1 must be list");
-    return make_vector(copy_list(list_obj), proper_list_length(list_obj, "list->vector"));
+    return list_to_vector(list_obj, proper_list_length(list_obj, "list->vector"));
 }
 
 static object* apply_procedure(object* arguments) {
@@ -756,51 +963,60 @@ static object* apply_procedure(object* arguments) {
     return result;
 }
 
+object* next_map_arguments(const char* proc_name, object* lists) {
+    object* call_args = the_empty_list;
+    object* call_tail = the_empty_list;
+    bool saw_empty = false;
+    bool saw_non_empty = false;
+
+    while(is_pair(lists)) {
+        object* current_list = car(lists);
+        if(is_empty_list(current_list)) {
+            saw_empty = true;
+        }
+        else if(is_pair(current_list)) {
+            object* arg_cell = cons(car(current_list), the_empty_list);
+            saw_non_empty = true;
+            if(is_empty_list(call_args))
+                call_args = arg_cell;
+            else
+                set_cdr(call_tail, arg_cell);
+            call_tail = arg_cell;
+            set_car(lists, cdr(current_list));
+        }
+        else {
+            primitive_error(proc_name, "list args must be proper lists");
+        }
+        lists = cdr(lists);
+    }
+
+    if(saw_empty) {
+        if(saw_non_empty)
+            primitive_error(proc_name, "list args have different lengths");
+        return NULL;
+    }
+    return call_args;
+}
+
 static object* map_procedure(object* arguments) {
     object* procedure;
     object* lists;
     object* head = the_empty_list;
     object* tail = the_empty_list;
+    object* value = NULL;
+    object* call_args;
 
     require_min_args("map", arguments, 2);
     procedure = car(arguments);
     lists = cdr(arguments);
-
-    while(true) {
-        object* iter = lists;
-        object* call_args = the_empty_list;
-        object* call_tail = the_empty_list;
-        bool saw_empty = false;
-        bool saw_non_empty = false;
-
-        while(is_pair(iter)) {
-            object* current_list = car(iter);
-            if(is_empty_list(current_list)) {
-                saw_empty = true;
-            }
-            else if(is_pair(current_list)) {
-                object* arg_cell = cons(car(current_list), the_empty_list);
-                saw_non_empty = true;
-                if(is_empty_list(call_args))
-                    call_args = arg_cell;
-                else
-                    set_cdr(call_tail, arg_cell);
-                call_tail = arg_cell;
-                set_car(iter, cdr(current_list));
-            }
-            else {
-                primitive_error("map", "list args must be proper lists");
-            }
-            iter = cdr(iter);
-        }
-
-        if(saw_empty) {
-            if(saw_non_empty)
-                primitive_error("map", "list args have different lengths");
-            break;
-        }
-
-        object* value = apply(procedure, call_args);
+    gc_protect(procedure);
+    gc_protect(lists);
+    gc_protect(head);
+    gc_protect(tail);
+    gc_protect(value);
+
+    while((call_args = next_map_arguments("map", lists)) != NULL) {
+        value = apply(procedure, call_args);
         object* cell = cons(value, the_empty_list);
         if(is_empty_list(head))
             head = cell;
@@ -809,54 +1025,25 @@ static object* map_procedure(object* arguments) {
         tail = cell;
     }
 
+    gc_unprotect(5);
     return head;
 }
 
 static object* for_each_procedure(object* arguments) {
     object* procedure;
     object* lists;
+    object* call_args;
 
     require_min_args("for-each", arguments, 2);
     procedure = car(arguments);
     lists = cdr(arguments);
+    gc_protect(procedure);
+    gc_protect(lists);
 
-    while(true) {
-        object* iter = lists;
-        object* call_args = the_empty_list;
-        object* call_tail = the_empty_list;
-        bool saw_empty = false;
-        bool saw_non_empty = false;
-
-        while(is_pair(iter)) {
-            object* current_list = car(iter);
-            if(is_empty_list(current_list)) {
-                saw_empty = true;
-            }
-            else if(is_pair(current_list)) {
-                object* arg_cell = cons(car(current_list), the_empty_list);
-                saw_non_empty = true;
-                if(is_empty_list(call_args))
-                    call_args = arg_cell;
-                else
-                    set_cdr(call_tail, arg_cell);
-                call_tail = arg_cell;
-                set_car(iter, cdr(current_list));
-            }
-            else {
-                primitive_error("for-each", "list args must be proper lists");
-            }
-            iter = cdr(iter);
-        }
-
-        if(saw_empty) {
-            if(saw_non_empty)
-                primitive_error("for-each", "list args have different lengths");
-            break;
-        }
-
+    while((call_args = next_map_arguments("for-each", lists)) != NULL)
         apply(procedure, call_args);
-    }
 
+    gc_unprotect(2);
     return ok_symbol;
 }
 
@@ -870,27 +1057,31 @@ static object* call_cc_procedure(object* arguments) {
         primitive_error("call/cc", "arg 1 must be procedure");
 
     continuation = make_continuation();
-    continuation->data.continuation.active = true;
+    gc_protect(continuation);
+    continuation->data.continuation.point->active = true;
+    continuation->data.continuation.point->root_count = gc_root_count;
 
-    if(setjmp(continuation->data.continuation.return_point) != 0) {
-        continuation->data.continuation.active = false;
+    if(setjmp(continuation->data.continuation.point->return_point) != 0) {
+        continuation->data.continuation.point->active = false;
+        gc_unprotect(1);
         return continuation->data.continuation.value;
     }
 
     continuation->data.continuation.value = NULL;
-    continuation->data.continuation.active = true;
+    continuation->data.continuation.point->active = true;
     arguments = apply(procedure, cons(continuation, the_empty_list));
-    continuation->data.continuation.active = false;
+    continuation->data.continuation.point->active = false;
+    gc_unprotect(1);
     return arguments;
 }
 
 static void display_object(FILE* out, object* obj) {
-    switch(obj->type) {
+    switch(type_of(obj)) {
         case STRING:
-            fprintf(out, "%s", obj->data.string.value);
+            fwrite(obj->data.string.value, 1, obj->data.string.length, out);
             break;
         case CHARACTER:
-            fputc(obj->data.character.value, out);
+            fputc(character_value(obj), out);
             break;
         default:
             write(out, obj);
@@ -1036,8 +1227,7 @@ static object* read_line_procedure(object* arguments) {
     if(length > 0 && buffer[length - 1] == '\r')
         length--;
 
-    buffer[length] = '\0';
-    result = make_string(buffer);
+    result = make_sized_string(buffer, length);
     free(buffer);
     return result;
 }
@@ -1093,42 +1283,51 @@ static object* newline_procedure(object* arguments) {
 void add_primitive_to_environment(object* env) {
 #define ADD_PRIMITIVE_PROCEDURE(scheme_name, c_name) \
     define_variable(make_symbol(scheme_name), make_primitive_procedure(c_name), env);
-
-    ADD_PRIMITIVE_PROCEDURE("+",                           add_procedure)
-    ADD_PRIMITIVE_PROCEDURE("-",                           sub_procedure)
-    ADD_PRIMITIVE_PROCEDURE("*",                           mul_procedure)
-    ADD_PRIMITIVE_PROCEDURE("/",                           div_procedure)
-    ADD_PRIMITIVE_PROCEDURE("quotient",                    div_procedure)
-    ADD_PRIMITIVE_PROCEDURE("remainder",             remainder_procedure)
-    ADD_PRIMITIVE_PROCEDURE("=",                  is_num_equal_procedure)
-    ADD_PRIMITIVE_PROCEDURE("<",                       is_less_procedure)
-    ADD_PRIMITIVE_PROCEDURE(">",                    is_greater_procedure)
-    ADD_PRIMITIVE_PROCEDURE("cons",                       cons_procedure)
-    ADD_PRIMITIVE_PROCEDURE("car",                         car_procedure)
-    ADD_PRIMITIVE_PROCEDURE("cdr",                         cdr_procedure)
+#define ADD_ARGV_PRIMITIVE_PROCEDURE(scheme_name, min_args, max_args, c_name, binary_name) \
+    define_variable(make_symbol(scheme_name), \
+                    make_argv_primitive_procedure(scheme_name, min_args, max_args, \
+                                                  c_name, binary_name), env);
+#define ANY PRIMITIVE_VARIADIC
+
+    ADD_ARGV_PRIMITIVE_PROCEDURE("+",           0, ANY, add_procedure,           add2_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("-",           1, ANY, sub_procedure,           sub2_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("*",           0, ANY, mul_procedure,           mul2_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("/",           2, 2,  div_procedure,           NULL)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("quotient",    2, 2,  div_procedure,           NULL)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("remainder",   2, 2,  remainder_procedure,     NULL)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("=",           2, ANY, is_num_equal_procedure,  is_num_equal2_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("<",           2, ANY, is_less_procedure,       is_less2_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE(">",           2, ANY, is_greater_procedure,    is_greater2_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("cons",        2, 2,  cons_procedure,          cons2_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("car",         1, 1,  car_procedure,           NULL)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("cdr",         1, 1,  cdr_procedure,           NULL)
     ADD_PRIMITIVE_PROCEDURE("set-car!",                set_car_procedure)
     ADD_PRIMITIVE_PROCEDURE("set-cdr!",                set_cdr_procedure)
     ADD_PRIMITIVE_PROCEDURE("list",                       list_procedure)
-    ADD_PRIMITIVE_PROCEDURE("eq?",                    is_equal_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("eq?",         2, 2,  is_equal_procedure,      is_equal2_procedure)
     ADD_PRIMITIVE_PROCEDURE("eqv?",                     is_eqv_procedure)
     ADD_PRIMITIVE_PROCEDURE("equal?",             is_equal_deep_procedure)
-    ADD_PRIMITIVE_PROCEDURE("null?",                   is_null_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("null?",       1, 1,  is_null_procedure,       NULL)
     ADD_PRIMITIVE_PROCEDURE("boolean?",                is_bool_procedure)
     ADD_PRIMITIVE_PROCEDURE("symbol?",               is_symbol_procedure)
     ADD_PRIMITIVE_PROCEDURE("integer?",             is_integer_procedure)
     ADD_PRIMITIVE_PROCEDURE("number?",              is_integer_procedure)
     ADD_PRIMITIVE_PROCEDURE("string?",               is_string_procedure)
     ADD_PRIMITIVE_PROCEDURE("char?",                   is_char_procedure)
-    ADD_PRIMITIVE_PROCEDURE("pair?",                   is_pair_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("pair?",       1, 1,  is_pair_procedure,       NULL)
     ADD_PRIMITIVE_PROCEDURE("vector?",               is_vector_procedure)
     ADD_PRIMITIVE_PROCEDURE("port?",                   is_port_procedure)
     ADD_PRIMITIVE_PROCEDURE("procedure?",         is_procedure_procedure)
     ADD_PRIMITIVE_PROCEDURE("char->integer",   char_to_integer_procedure)
     ADD_PRIMITIVE_PROCEDURE("integer->char",   integer_to_char_procedure)
     ADD_PRIMITIVE_PROCEDURE("vector",                 vector_procedure)
+    ADD_PRIMITIVE_PROCEDURE("make-vector",       make_vector_procedure)
     ADD_PRIMITIVE_PROCEDURE("vector-length",   vector_length_procedure)
-    ADD_PRIMITIVE_PROCEDURE("vector-ref",         vector_ref_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("vector-ref",  2, 2,  vector_ref_procedure,    NULL)
     ADD_PRIMITIVE_PROCEDURE("vector-set!",       vector_set_procedure)
+    ADD_PRIMITIVE_PROCEDURE("vector-fill!",     vector_fill_procedure)
+    ADD_PRIMITIVE_PROCEDURE("vector-copy",       vector_copy_procedure)
+    ADD_PRIMITIVE_PROCEDURE("vector-grow",       vector_grow_procedure)
     ADD_PRIMITIVE_PROCEDURE("vector->list",   vector_to_list_procedure)
     ADD_PRIMITIVE_PROCEDURE("list->vector",   list_to_vector_procedure)
     ADD_PRIMITIVE_PROCEDURE("apply",                   apply_procedure)
@@ -1140,7 +1339,10 @@ void add_primitive_to_environment(object* env) {
     ADD_PRIMITIVE_PROCEDURE("symbol->string", symbol_to_string_procedure)
     ADD_PRIMITIVE_PROCEDURE("string->symbol", string_to_symbol_procedure)
     ADD_PRIMITIVE_PROCEDURE("string-length", string_length_procedure)
-    ADD_PRIMITIVE_PROCEDURE("string-ref", string_ref_procedure)
+    ADD_PRIMITIVE_PROCEDURE("make-string", make_string_procedure)
+    ADD_ARGV_PRIMITIVE_PROCEDURE("string-ref",  2, 2,  string_ref_procedure,    NULL)
+    ADD_PRIMITIVE_PROCEDURE("string-set!", string_set_procedure)
+    ADD_PRIMITIVE_PROCEDURE("string-copy!", string_copy_to_procedure)
     ADD_PRIMITIVE_PROCEDURE("substring", substring_procedure)
     ADD_PRIMITIVE_PROCEDURE("string-append", string_append_procedure)
     ADD_PRIMITIVE_PROCEDURE("environment",         environment_procedure)
@@ -1157,5 +1359,8 @@ void add_primitive_to_environment(object* env) {
     ADD_PRIMITIVE_PROCEDURE("current-input-port", current_input_port_procedure)
     ADD_PRIMITIVE_PROCEDURE("current-output-port", current_output_port_procedure)
     ADD_PRIMITIVE_PROCEDURE("load",                     load_procedure)
+    ADD_PRIMITIVE_PROCEDURE("gc-pauses",           gc_pauses_procedure)
+    ADD_PRIMITIVE_PROCEDURE("gc-pauses-over-target", gc_pauses_over_target_procedure)
 
+#undef ANY
 }
@@ -8,142 +8,309 @@
 #include "header/error.h"
 #include "header/read.h"
 #include "header/object.h"
+#include "header/gc.h"
 
-object* lookup_variable_value(object* var, object* env) {
-    while(!is_empty_list(env)) {
-        object* frame = first_frame(env);
-        object* vars = frame_variables(frame);
-        object* vals = frame_values(frame);
-        while(!is_empty_list(vars)) {
-            if(!is_pair(vars) || !is_pair(vals))
-                error_handle(stderr, "invalid environment frame", EXIT_FAILURE);
-
-            if(var == car(vars))
-                return car(vals);
-
-            vars = cdr(vars);
-            vals = cdr(vals);
-        }
-        if(!is_empty_list(vals))
-            error_handle(stderr, "invalid environment frame", EXIT_FAILURE);
-        env = enclosing_environment(env);
-    }
+bool frames_extended = false;
+
+static void undefined_variable(object* var) {
     char error_msg[TOKEN_MAX + 50];
     sprintf(error_msg, "undefined variable: %s\n", var->data.symbol.value);
     error_handle(stderr, error_msg, EXIT_FAILURE);
-    return NULL;
 }
 
-object* extend_environment(object* variables,
-                           object* values,
-                           object* base_env) {
-    object* vars_iter = variables;
-    object* vals_iter = values;
+/* the top level keeps its bindings on the symbols */
+static bool is_top_level(object* frame) {
+    return is_empty_list(frame->data.frame.parent);
+}
 
-    /* variadic form: (lambda args body...) */
-    if(is_symbol(variables))
-        return cons(make_frame(cons(variables, the_empty_list),
-                               cons(values, the_empty_list)),
-                    base_env);
+/*
+ * A slot holding a box shares its value with the closures capturing it.
+ * The cell functions also return the object the cell is part of, for
+ * the write barrier of the assignments.
+ */
+static object** unbox_cell(object** cell, object** owner) {
+    if(*cell != NULL && !is_immediate(*cell) && (*cell)->type == BOX) {
+        *owner = *cell;
+        return &(*cell)->data.box.value;
+    }
+    return cell;
+}
 
-    while(!is_empty_list(vars_iter) && !is_empty_list(vals_iter)) {
-        if(!is_pair(vars_iter))
-            error_handle(stderr, "invalid parameter list", EXIT_FAILURE);
-        if(!is_pair(vals_iter))
-            error_handle(stderr, "invalid argument list", EXIT_FAILURE);
+/* the slot of var in frame, or NULL when the frame does not bind it */
+static object** frame_cell(object* var, object* frame, object** owner) {
+    object* variables = frame->data.frame.variables;
 
-        vars_iter = cdr(vars_iter);
-        vals_iter = cdr(vals_iter);
+    if(is_top_level(frame)) {
+        *owner = var;
+        return var->data.symbol.global_value == NULL ? NULL : &var->data.symbol.global_value;
     }
 
-    if(!is_empty_list(vars_iter)) {
-        if(!is_pair(vars_iter))
-            error_handle(stderr, "invalid parameter list", EXIT_FAILURE);
-        error_handle(stderr, "too few arguments supplied", EXIT_FAILURE);
+    *owner = frame;
+    for(size_t i = 0; i < variables->data.vector.length; i++) {
+        if(variables->data.vector.elements[i] == var)
+            return unbox_cell(&frame->data.frame.values[i], owner);
     }
+    for(object* extra = frame->data.frame.extra; !is_empty_list(extra); extra = cdr(extra)) {
+        if(car(car(extra)) == var) {
+            *owner = car(extra);
+            return &car(extra)->data.pair.cdr;
+        }
+    }
+    return NULL;
+}
 
-    if(!is_empty_list(vals_iter)) {
-        if(!is_pair(vals_iter))
-            error_handle(stderr, "invalid argument list", EXIT_FAILURE);
-        error_handle(stderr, "too many arguments supplied", EXIT_FAILURE);
+object* lookup_variable_value(object* var, object* env) {
+    object* owner;
+
+    for(; !is_empty_list(env); env = enclosing_environment(env)) {
+        object** cell = frame_cell(var, env, &owner);
+        if(cell != NULL) {
+            /* an internal definition that has not run yet */
+            if(*cell == NULL)
+                undefined_variable(var);
+            return *cell;
+        }
     }
+    undefined_variable(var);
+    return NULL;
+}
+
+object* extend_environment(object* variables,
+                           object* values,
+                           object* base_env) {
+    size_t count = 0;
+    object* frame;
 
-    return cons(make_frame(variables, values), base_env);
+    for(object* iter = variables; is_pair(iter); iter = cdr(iter))
+        count++;
+    if(is_empty_list(base_env))
+        frame = make_frame(0, list_to_vector(the_empty_list, 0), base_env);
+    else
+        frame = make_frame(count, list_to_vector(variables, count), base_env);
+    for(size_t i = 0; i < count; i++, variables = cdr(variables)) {
+        if(!is_pair(values))
+            error_handle(stderr, "too few arguments supplied", EXIT_FAILURE);
+        if(is_top_level(frame))
+            define_variable(car(variables), car(values), frame);
+        else
+            frame->data.frame.values[i] = car(values);
+        values = cdr(values);
+    }
+    if(!is_empty_list(values))
+        error_handle(stderr, "too many arguments supplied", EXIT_FAILURE);
+    return frame;
 }
 
 void set_variable_value(object* var, object* value, object* env) {
-    while(!is_empty_list(env)) {
-        object* frame = first_frame(env);
-        object* vars = frame_variables(frame);
-        object* vals = frame_values(frame);
-
-        while(!is_empty_list(vars)) {
-            if(!is_pair(vars) || !is_pair(vals))
-                error_handle(stderr, "invalid environment frame", EXIT_FAILURE);
-
-            if(var == car(vars)){
-                set_car(vals, value);
-                return;
-            }
-            vars = cdr(vars);
-            vals = cdr(vals);
+    object* owner;
+
+    for(; !is_empty_list(env); env = enclosing_environment(env)) {
+        object** cell = frame_cell(var, env, &owner);
+        if(cell != NULL) {
+            *cell = value;
+            gc_write_barrier(owner, value);
+            return;
         }
-        if(!is_empty_list(vals))
-            error_handle(stderr, "invalid environment frame", EXIT_FAILURE);
-        env = enclosing_environment(env);
     }
-
-    char error_msg[TOKEN_MAX + 50];
-    sprintf(error_msg, "undefined variable: %s\n", var->data.symbol.value);
-    error_handle(stderr, error_msg, EXIT_FAILURE);
+    undefined_variable(var);
 }
 
 void define_variable(object* var, object* val, object* env) {
-    if(!is_empty_list(env)) {
-        object* frame = first_frame(env);
-        object* vars = frame_variables(frame);
-        object* vals = frame_values(frame);
-
-        while(!is_empty_list(vars)) {
-            if(!is_pair(vars) || !is_pair(vals))
-                error_handle(stderr, "invalid environment frame", EXIT_FAILURE);
-
-            if(var == car(vars)) {
-                set_car(vals, val);
-                return;
-            }
-            vars = cdr(vars);
-            vals = cdr(vals);
-        }
-        if(!is_empty_list(vals))
-            error_handle(stderr, "invalid environment frame", EXIT_FAILURE);
+    object** cell;
+    object* owner;
 
-        /* undefined in first frame, add binding */
-        add_binding_to_frame(var, val, frame);
+    if(is_empty_list(env))
+        return;
+    if(is_top_level(env)) {
+        if(var->data.symbol.global_value == NULL)
+            add_global_symbol(var);
+        var->data.symbol.global_value = val;
+        gc_write_barrier(var, val);
+        return;
     }
+    cell = frame_cell(var, env, &owner);
+    if(cell != NULL) {
+        *cell = val;
+        gc_write_barrier(owner, val);
+        return;
+    }
+
+    /* undefined in first frame, add binding */
+    env->data.frame.extra = cons(cons(var, val), env->data.frame.extra);
+    gc_write_barrier(env, env->data.frame.extra);
+    frames_extended = true;
 }
 
-object* enclosing_environment(object* env) {
-    return cdr(env);
+static object** lexical_cell(long address, object* env, object** owner) {
+    if(lexical_depth(address) > 0)
+        env = enclosing_environment(env);
+    *owner = env;
+    return &env->data.frame.values[lexical_slot(address)];
+}
+
+object* lookup_lexical_value(object* var, long address, object* env) {
+    object* owner;
+    object* value = *unbox_cell(lexical_cell(address, env, &owner), &owner);
+    /* an internal definition that has not run yet */
+    if(value == NULL)
+        undefined_variable(var);
+    return value;
+}
+
+void set_lexical_value(object* var, long address, object* value, object* env) {
+    object* owner;
+    object** cell = unbox_cell(lexical_cell(address, env, &owner), &owner);
+
+    if(*cell == NULL)
+        undefined_variable(var);
+    *cell = value;
+    gc_write_barrier(owner, value);
+}
+
+void define_lexical_value(long address, object* value, object* env) {
+    object* owner;
+
+    *unbox_cell(lexical_cell(address, env, &owner), &owner) = value;
+    gc_write_barrier(owner, value);
+}
+
+/*
+ * The environment of a closure is a frame holding the variables it
+ * captures, taken from env at the given lexical addresses. Boxes are
+ * copied as they are, so that the variables stay shared. Once names
+ * may be added to the frames of procedure calls, which are looked up by
+ * name, or when keep_env asks for it, the closure keeps all of env
+ * above its own frame instead of just the top level.
+ */
+object* capture_variables(object* names, object* addresses, bool keep_env, object* env) {
+    size_t count = names->data.vector.length;
+    object* parent = keep_env || frames_extended ? env : the_global_environment;
+    object* frame;
+    object* owner;
+
+    if(count == 0)
+        return parent;
+    frame = make_frame(count, names, parent);
+    for(size_t i = 0; i < count; i++)
+        frame->data.frame.values[i] =
+                *lexical_cell(fixnum_value(addresses->data.vector.elements[i]), env, &owner);
+    return frame;
 }
 
-object* first_frame(object* env) {
-    return car(env);
+object* top_level_value(object* var) {
+    return var->data.symbol.global_value;
 }
 
-object* make_frame(object* variables, object* values) {
-    return cons(variables, values);
+object* lookup_global_value(object* var, object* env) {
+    /* names added at run time may shadow the global binding */
+    if(frames_extended)
+        return lookup_variable_value(var, env);
+    if(var->data.symbol.global_value == NULL)
+        undefined_variable(var);
+    return var->data.symbol.global_value;
 }
 
-object* frame_variables(object* frame) {
-    return car(frame);
+void set_global_value(object* var, object* value, object* env) {
+    if(frames_extended || var->data.symbol.global_value == NULL)
+        set_variable_value(var, value, env);
+    else {
+        var->data.symbol.global_value = value;
+        gc_write_barrier(var, value);
+    }
+}
+
+static void box_slots(object* procedure, object* frame) {
+    object* boxed = procedure->data.compound_proc.boxed;
+
+    if(boxed == NULL)
+        return;
+    for(size_t i = 0; i < boxed->data.vector.length; i++) {
+        object** cell = &frame->data.frame.values[fixnum_value(boxed->data.vector.elements[i])];
+        *cell = make_box(*cell);
+    }
+}
+
+/*
+ * The frame of a call has a slot for every parameter followed by one for
+ * every internal definition of the body, so it is allocated once at its
+ * final size. The definition slots stay NULL until the definition runs.
+ */
+object* extend_procedure_environment(object* procedure, object* arguments) {
+    object* parameters = procedure->data.compound_proc.parameters;
+    object* variables = procedure->data.compound_proc.variables;
+    object* frame = make_frame(variables->data.vector.length, variables,
+                               procedure->data.compound_proc.env);
+    object** values = frame->data.frame.values;
+
+    /* variadic form: (lambda args body...) */
+    if(is_symbol(parameters)) {
+        values[0] = arguments;
+        box_slots(procedure, frame);
+        return frame;
+    }
+
+    while(!is_empty_list(parameters) && !is_empty_list(arguments)) {
+        if(!is_pair(parameters))
+            error_handle(stderr, "invalid parameter list", EXIT_FAILURE);
+        if(!is_pair(arguments))
+            error_handle(stderr, "invalid argument list", EXIT_FAILURE);
+
+        *values++ = car(arguments);
+        parameters = cdr(parameters);
+        arguments = cdr(arguments);
+    }
+
+    if(!is_empty_list(parameters)) {
+        if(!is_pair(parameters))
+            error_handle(stderr, "invalid parameter list", EXIT_FAILURE);
+        error_handle(stderr, "too few arguments supplied", EXIT_FAILURE);
+    }
+
+    if(!is_empty_list(arguments)) {
+        if(!is_pair(arguments))
+            error_handle(stderr, "invalid argument list", EXIT_FAILURE);
+        error_handle(stderr, "too many arguments supplied", EXIT_FAILURE);
+    }
+
+    box_slots(procedure, frame);
+    return frame;
 }
 
-object* frame_values(object* frame) {
-    return cdr(frame);
+/* the same for arguments that are not in a list, argv[0] being the first */
+object* extend_procedure_environment_argv(object* procedure, size_t argc, object** argv) {
+    object* parameters = procedure->data.compound_proc.parameters;
+    object* variables = procedure->data.compound_proc.variables;
+    object* frame;
+    object** values;
+
+    if(is_symbol(parameters)) {
+        object* arguments = the_empty_list;
+        while(argc > 0)
+            arguments = cons(argv[--argc], arguments);
+        return extend_procedure_environment(procedure, arguments);
+    }
+
+    frame = make_frame(variables->data.vector.length, variables,
+                       procedure->data.compound_proc.env);
+    values = frame->data.frame.values;
+    for(; argc > 0 && is_pair(parameters); argc--) {
+        *values++ = *argv++;
+        parameters = cdr(parameters);
+    }
+
+    if(!is_empty_list(parameters)) {
+        if(!is_pair(parameters))
+            error_handle(stderr, "invalid parameter list", EXIT_FAILURE);
+        error_handle(stderr, "too few arguments supplied", EXIT_FAILURE);
+    }
+
+    if(argc > 0)
+        error_handle(stderr, "too many arguments supplied", EXIT_FAILURE);
+
+    box_slots(procedure, frame);
+    return frame;
 }
 
-void add_binding_to_frame(object* var, object* val, object* frame) {
-    set_car(frame, cons(var, car(frame)));
-    set_cdr(frame, cons(val, cdr(frame)));
+object* enclosing_environment(object* env) {
+    return env->data.frame.parent;
 }
@@ -9,11 +9,17 @@
 #include "header/error.h"
 #include "header/read.h"
 #include "header/object.h"
+#include "header/gc.h"
+#include "header/vm.h"
 
 static jmp_buf* active_recovery_point = NULL;
+static size_t recovery_root_count = 0;
+static size_t recovery_vm_height = 0;
 
 void set_error_recovery(jmp_buf* recovery_point) {
     active_recovery_point = recovery_point;
+    recovery_root_count = gc_root_count;
+    recovery_vm_height = vm_stack_top;
 }
 
 void clear_error_recovery(void) {
@@ -22,8 +28,12 @@ void clear_error_recovery(void) {
 
 static void exit_or_recover(int exit_code) {
     fflush(stdout);
-    if(active_recovery_point != NULL)
+    if(active_recovery_point != NULL) {
+        /* the C frames that registered roots above this point are gone */
+        gc_root_count = recovery_root_count;
+        vm_unwind(recovery_vm_height);
         longjmp(*active_recovery_point, 1);
+    }
     exit(exit_code);
 }
 
@@ -47,7 +57,7 @@ void error_handle_with_object(FILE* out,
     char error_msg[TOKEN_MAX + 50];
 
     if(obj != NULL) {
-        switch(obj->type) {
+        switch(type_of(obj)) {
             case SYMBOL:
                 sprintf(error_msg, "%s: %s", msg, obj->data.symbol.value);
                 print_error_text(out, error_msg);
@@ -57,7 +67,7 @@ void error_handle_with_object(FILE* out,
                 print_error_text(out, error_msg);
                 exit_or_recover(exit_code);
             case FIXNUM:
-                sprintf(error_msg, "%s: %ld", msg, obj->data.fixnum.value);
+                sprintf(error_msg, "%s: %ld", msg, fixnum_value(obj));
                 print_error_text(out, error_msg);
                 exit_or_recover(exit_code);
             default:
@@ -0,0 +1,1568 @@
+//
+// page based object heap and generational collector
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "header/gc.h"
+#include "header/object.h"
+#include "header/error.h"
+#include "header/vm.h"
+
+/* gc.h tells whether the parallel collector is built */
+#ifdef GC_PARALLEL
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/* header type of a cell that is not holding an object */
+#define FREE_CELL ((object_type) 0xff)
+/* header type of a nursery object that was copied to the old space */
+#define FORWARDED ((object_type) 0xfe)
+/* header type of the dead space between the objects a minor collection
+ * left in place on a nursery page */
+#define FILLER    ((object_type) 0xfd)
+
+#define SIZE_CLASS_COUNT (sizeof(size_classes) / sizeof(size_classes[0]))
+#define MAX_CELL_SIZE    256
+
+/* a stack scanner reads from its own frame up, redzones included */
+#ifdef __GNUC__
+#define SCANS_STACK __attribute__((noinline, no_sanitize_address))
+#else
+#define SCANS_STACK
+#endif
+
+typedef struct free_cell {
+    object_type type;
+    bool gc_remembered;
+    struct free_cell* next;
+} free_cell;
+
+typedef struct {
+    object_type type;
+    bool gc_remembered;
+    object* copy;
+} forwarded;
+
+typedef struct {
+    object_type type;
+    bool gc_remembered;
+    size_t size;
+} filler;
+
+typedef struct {
+    object** objects;
+    size_t count;
+    size_t capacity;
+} object_stack;
+
+typedef struct {
+    gc_page* pages;
+    gc_page* last;
+    gc_page* current;      /* allocation cursor, earlier pages are full */
+} size_class;
+
+static const size_t size_classes[] = {16, 24, 32, 48, 64, 96, 128, 192, 256};
+
+static size_class heap_classes[sizeof(size_classes) / sizeof(size_classes[0])];
+static unsigned char size_class_index[MAX_CELL_SIZE / 8 + 1];
+static gc_page* large_pages = NULL;
+static bool heap_initialized = false;
+
+/* the major collection sweeps the pages of older epochs */
+static unsigned sweep_epoch = 0;
+/* the pages the allocator may still sweep until the next minor collection */
+static size_t lazy_sweeps = GC_SWEEP_STEP;
+
+/*
+ * The nursery pages in use come first in nursery, the one being filled
+ * last. Allocation bumps nursery_bump up to nursery_limit within it.
+ * Pages beyond GC_NURSERY_PAGES are only added when the nursery fills
+ * up before the next safepoint, and freed again by the minor collection.
+ */
+static gc_page** nursery = NULL;
+static size_t nursery_used = 0;
+static size_t nursery_count = 0;
+static size_t nursery_capacity = 0;
+static gc_page* nursery_page = NULL;
+static char* nursery_bump = NULL;
+static char* nursery_limit = NULL;
+
+/* old objects that may point into the nursery */
+static object_stack remembered = {NULL, 0, 0};
+
+/* young objects to finalize unless they survive */
+static object_stack finalizable = {NULL, 0, 0};
+
+/*
+ * Both collections are iterative, the objects whose references are
+ * still to be visited wait on a stack. For the minor collection these
+ * are the copies it made and the objects it left in place, for the
+ * major one the gray objects, marked but not scanned yet. The C stack
+ * stays flat however deep the data is.
+ */
+static object_stack copied = {NULL, 0, 0};
+static object_stack gray = {NULL, 0, 0};
+
+static char* stack_base = NULL;
+
+/* the old space is collected when it grew by collect_threshold */
+static size_t bytes_since_collect = 0;
+static size_t collect_threshold = GC_MIN_BUDGET;
+static size_t live_bytes = 0;
+static size_t swept_live_bytes = 0;
+static bool major_pending = false;
+#ifdef GC_STRESS
+/* safepoints left to pass before the next collection */
+static size_t stress_skips = 0;
+#endif
+
+/* pause statistics, the per collection ones are printed when reporting */
+static size_t minor_collections = 0;
+static size_t major_collections = 0;
+static size_t pause_count = 0;
+static size_t pauses_over_target = 0;
+static double longest_pause = 0;
+static double total_pause = 0;
+static size_t cycle_pauses = 0;
+static double cycle_longest_pause = 0;
+static double cycle_total_pause = 0;
+
+/* mark and sweep throughput, the times are only taken when reporting */
+static size_t objects_marked = 0;
+static size_t objects_swept = 0;
+static double mark_time = 0;
+static double sweep_time = 0;
+static size_t cycle_marked = 0;
+static size_t cycle_swept = 0;
+static double cycle_mark_time = 0;
+static double cycle_sweep_time = 0;
+
+object*** gc_roots = NULL;
+size_t gc_root_count = 0;
+size_t gc_root_capacity = 0;
+bool gc_pending = false;
+bool gc_marking = false;
+bool gc_sweeping = false;
+size_t gc_mark_step = GC_MARK_STEP;
+size_t gc_threads = 1;
+bool gc_report_pauses = false;
+
+static void sweep_lazily(gc_page* page);
+
+static size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/* doubles the capacity of a growable array */
+static void* grow_array(void* array, size_t* capacity, size_t element_size) {
+    size_t new_capacity = *capacity == 0 ? 256 : *capacity * 2;
+
+    array = realloc(array, new_capacity * element_size);
+    if(array == NULL)
+        error_handle(stderr, "out of memory", EXIT_FAILURE);
+    *capacity = new_capacity;
+    return array;
+}
+
+static void push(object_stack* stack, object* obj) {
+    if(stack->count == stack->capacity)
+        stack->objects = (object**) grow_array(stack->objects, &stack->capacity, sizeof(object*));
+    stack->objects[stack->count++] = obj;
+}
+
+static double now_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec * 1e3 + (double) now.tv_nsec / 1e6;
+}
+
+/* the time in ms when reporting, so that phases can be timed cheaply */
+static double report_clock(void) {
+    return gc_report_pauses ? now_ms() : 0;
+}
+
+static void heap_init(void) {
+    size_t class = 0;
+
+    for(size_t words = 0; words <= MAX_CELL_SIZE / 8; words++) {
+        while(size_classes[class] < words * 8)
+            class++;
+        size_class_index[words] = (unsigned char) class;
+    }
+    heap_initialized = true;
+}
+
+/*
+ * The old pages by address, to look the words on the C stack up: an
+ * open addressing table of the GC_PAGE_SIZE blocks that old pages
+ * cover, a large page with every block it spans, so that the lookup
+ * does not grow with the heap.
+ */
+#define PAGE_TABLE_MIN_CAPACITY 256
+#define PAGE_TOMBSTONE ((uintptr_t) 1)
+
+typedef struct page_entry {
+    uintptr_t block;           /* 0 when the entry was never used */
+    gc_page* page;
+} page_entry;
+
+static page_entry* page_table = NULL;
+static size_t page_table_capacity = 0;
+static size_t page_table_used = 0;     /* live entries and tombstones */
+static size_t page_table_live = 0;
+
+static size_t hash_block(uintptr_t block) {
+    /* Fibonacci hashing, the high bits are the well mixed ones */
+    return (size_t) (((uint64_t) (block / GC_PAGE_SIZE) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static void page_table_insert(uintptr_t block, gc_page* page) {
+    size_t mask = page_table_capacity - 1;
+    size_t i = hash_block(block) & mask;
+
+    while(page_table[i].block != 0 && page_table[i].block != PAGE_TOMBSTONE)
+        i = (i + 1) & mask;
+    if(page_table[i].block == 0)
+        page_table_used++;
+    page_table[i].block = block;
+    page_table[i].page = page;
+    page_table_live++;
+}
+
+static void page_table_resize(void) {
+    page_entry* old_table = page_table;
+    size_t old_capacity = page_table_capacity;
+    size_t capacity = PAGE_TABLE_MIN_CAPACITY;
+
+    while(capacity < page_table_live * 4)
+        capacity *= 2;
+
+    page_table = (page_entry*) calloc(capacity, sizeof(page_entry));
+    if(page_table == NULL)
+        error_handle(stderr, "out of memory", EXIT_FAILURE);
+    page_table_capacity = capacity;
+    page_table_used = 0;
+    page_table_live = 0;
+
+    for(size_t i = 0; i < old_capacity; i++)
+        if(old_table[i].block != 0 && old_table[i].block != PAGE_TOMBSTONE)
+            page_table_insert(old_table[i].block, old_table[i].page);
+    free(old_table);
+}
+
+static page_entry* page_table_find(uintptr_t block) {
+    size_t mask = page_table_capacity - 1;
+
+    if(page_table_capacity == 0)
+        return NULL;
+    for(size_t i = hash_block(block) & mask; page_table[i].block != 0; i = (i + 1) & mask)
+        if(page_table[i].block == block)
+            return &page_table[i];
+    return NULL;
+}
+
+static void add_old_page(gc_page* page) {
+    for(uintptr_t block = (uintptr_t) page; block < (uintptr_t) page->limit; block += GC_PAGE_SIZE) {
+        if((page_table_used + 1) * 2 > page_table_capacity)
+            page_table_resize();
+        page_table_insert(block, page);
+    }
+}
+
+static void remove_old_page(gc_page* page) {
+    for(uintptr_t block = (uintptr_t) page; block < (uintptr_t) page->limit; block += GC_PAGE_SIZE) {
+        page_table_find(block)->block = PAGE_TOMBSTONE;
+        page_table_live--;
+    }
+}
+
+static gc_page* new_page(size_t cell_size, size_t page_size) {
+    gc_page* page;
+
+    if(posix_memalign((void**) &page, GC_PAGE_SIZE, page_size) != 0)
+        error_handle(stderr, "out of memory", EXIT_FAILURE);
+
+    page->next = NULL;
+    page->cell_size = cell_size;
+    page->cells = (char*) page + round_up(sizeof(gc_page), 16);
+    page->bump = page->cells;
+    if(cell_size == 0)
+        page->limit = (char*) page + page_size;
+    else
+        page->limit = page->cells +
+                      (page_size - (size_t)(page->cells - (char*) page)) / cell_size * cell_size;
+    page->free_list = NULL;
+    page->young = false;
+    page->pinned = false;
+    page->sweep_epoch = sweep_epoch;
+    memset(page->marks, 0, sizeof(page->marks));
+    if(cell_size != 0)
+        add_old_page(page);
+    return page;
+}
+
+static void set_mark(object* obj) {
+    gc_page_of(obj)->marks[gc_mark_bit(obj) / 64] |= (uint64_t) 1 << (gc_mark_bit(obj) % 64);
+}
+
+static object* page_allocate(gc_page* page) {
+    free_cell* cell = page->free_list;
+
+    if(cell != NULL) {
+        page->free_list = cell->next;
+        return (object*) cell;
+    }
+    if(page->bump < page->limit) {
+        object* obj = (object*) page->bump;
+        page->bump += page->cell_size;
+        return obj;
+    }
+    return NULL;
+}
+
+static object* allocate_small(size_class* class, size_t cell_size) {
+    object* obj;
+    gc_page* page;
+
+    while(class->current != NULL) {
+        /* after marking, a page is swept once the cursor gets to it */
+        if(class->current->sweep_epoch != sweep_epoch) {
+            if(lazy_sweeps == 0)
+                break;
+            lazy_sweeps--;
+            sweep_lazily(class->current);
+        }
+        obj = page_allocate(class->current);
+        if(obj != NULL)
+            return obj;
+        class->current = class->current->next;
+    }
+
+    /* every page is full, or the cursor sweeps no more pages until the
+     * next minor collection: a fresh one goes after the cursor, which
+     * leaves the page there to sweep_step */
+    page = new_page(cell_size, GC_PAGE_SIZE);
+    if(class->current != NULL) {
+        page->next = class->current->next;
+        class->current->next = page;
+        if(class->last == class->current)
+            class->last = page;
+    }
+    else {
+        if(class->last == NULL)
+            class->pages = page;
+        else
+            class->last->next = page;
+        class->last = page;
+    }
+    class->current = page;
+    return page_allocate(page);
+}
+
+static object* allocate_large(size_t size) {
+    gc_page* page = new_page(size, round_up(sizeof(gc_page), 16) + size);
+    page->next = large_pages;
+    large_pages = page;
+    return page_allocate(page);
+}
+
+void gc_account(size_t size) {
+    bytes_since_collect += size;
+    if(bytes_since_collect >= collect_threshold) {
+        major_pending = true;
+        gc_pending = true;
+    }
+}
+
+/* size is a multiple of 8 */
+static object* allocate_old(size_t size) {
+    object* obj;
+
+    if(!heap_initialized)
+        heap_init();
+
+    if(size <= MAX_CELL_SIZE) {
+        size_t class = size_class_index[size / 8];
+        obj = allocate_small(&heap_classes[class], size_classes[class]);
+        size = size_classes[class];
+    }
+    else {
+        obj = allocate_large(size);
+    }
+    obj->gc_remembered = false;
+    gc_account(size);
+    return obj;
+}
+
+/* moves the allocation cursor to the next nursery page */
+static void nursery_refill(void) {
+    if(nursery_page != NULL)
+        nursery_page->bump = nursery_bump;
+    if(nursery_used == nursery_count) {
+        if(nursery_count == nursery_capacity)
+            nursery = (gc_page**) grow_array(nursery, &nursery_capacity, sizeof(gc_page*));
+        nursery[nursery_count] = new_page(0, GC_PAGE_SIZE);
+        nursery[nursery_count]->young = true;
+        nursery_count++;
+    }
+    nursery_page = nursery[nursery_used++];
+    nursery_bump = nursery_page->bump;
+    nursery_limit = nursery_page->limit;
+    /* a major collection advances by one step per nursery page */
+    if(nursery_used >= GC_NURSERY_PAGES || gc_marking || gc_sweeping)
+        gc_pending = true;
+}
+
+/* objects that become old while marking is under way start out gray */
+static void shade_new(object* obj) {
+    if(gc_marking) {
+        set_mark(obj);
+        push(&gray, obj);
+    }
+}
+
+object* gc_allocate(size_t size) {
+    object* obj;
+
+    size = round_up(size, 8);
+    if(size > MAX_CELL_SIZE) {
+        /* too big for the nursery, it starts out old and remembered */
+        obj = allocate_old(size);
+        gc_remember(obj);
+        shade_new(obj);
+        return obj;
+    }
+
+    /* a page that keeps pinned objects may not have room left */
+    while((size_t) (nursery_limit - nursery_bump) < size)
+        nursery_refill();
+    obj = (object*) nursery_bump;
+    nursery_bump += size;
+    obj->gc_remembered = false;
+    return obj;
+}
+
+object* gc_allocate_tenured(size_t size) {
+    object* obj = allocate_old(round_up(size, 8));
+
+    shade_new(obj);
+    return obj;
+}
+
+void gc_remember(object* obj) {
+    obj->gc_remembered = true;
+    push(&remembered, obj);
+}
+
+/* marks an old object, true when it was not marked before */
+static bool mark(object* obj) {
+    gc_page* page;
+    uint64_t* word;
+    uint64_t bit;
+
+    if(obj == NULL || is_immediate(obj))
+        return false;
+    page = gc_page_of(obj);
+    word = &page->marks[gc_mark_bit(obj) / 64];
+    bit = (uint64_t) 1 << (gc_mark_bit(obj) % 64);
+    if(page->young || (*word & bit) != 0)
+        return false;
+    *word |= bit;
+    return true;
+}
+
+void gc_shade(object* obj) {
+    if(mark(obj))
+        push(&gray, obj);
+}
+
+/* the sweep only frees what is unmarked on a page it did not get to yet */
+void gc_revive(object* obj) {
+    if(gc_marking)
+        gc_shade(obj);
+    else if(gc_sweeping && gc_page_of(obj)->sweep_epoch != sweep_epoch)
+        set_mark(obj);
+}
+
+void gc_track_finalizer(object* obj) {
+    if(gc_is_young(obj))
+        push(&finalizable, obj);
+}
+
+void gc_set_stack_base(void* base) {
+    stack_base = (char*) base;
+}
+
+void gc_grow_roots(void) {
+    gc_roots = (object***) grow_array(gc_roots, &gc_root_capacity, sizeof(object**));
+}
+
+/* calls visit with the address of every reference obj holds */
+static void scan_object(object* obj, void (*visit)(object** slot)) {
+    switch(obj->type) {
+        case PAIR:
+            visit(&obj->data.pair.car);
+            visit(&obj->data.pair.cdr);
+            break;
+        case VECTOR:
+            for(size_t i = 0; i < obj->data.vector.length; i++)
+                visit(&obj->data.vector.elements[i]);
+            break;
+        case MACRO:
+            visit(&obj->data.macro.literals);
+            visit(&obj->data.macro.rules);
+            visit(&obj->data.macro.env);
+            break;
+        case SYMBOL:
+            visit(&obj->data.symbol.global_value);
+            break;
+        case CONTINUATION:
+            visit(&obj->data.continuation.value);
+            visit(&obj->data.continuation.parent);
+            visit(&obj->data.continuation.frames);
+            break;
+        case COMPOUND_PROC:
+            visit(&obj->data.compound_proc.parameters);
+            visit(&obj->data.compound_proc.variables);
+            visit(&obj->data.compound_proc.body);
+            visit(&obj->data.compound_proc.env);
+            visit(&obj->data.compound_proc.boxed);
+            break;
+        case NODE:
+            visit(&obj->data.node.first);
+            visit(&obj->data.node.second);
+            visit(&obj->data.node.third);
+            visit(&obj->data.node.code);
+            visit(&obj->data.node.expansion);
+            break;
+        case CODE:
+            visit(&obj->data.code.constants);
+            break;
+        case FRAME:
+            visit(&obj->data.frame.parent);
+            visit(&obj->data.frame.variables);
+            visit(&obj->data.frame.extra);
+            for(size_t i = 0; i < obj->data.frame.count; i++)
+                visit(&obj->data.frame.values[i]);
+            break;
+        case BOX:
+            visit(&obj->data.box.value);
+            break;
+        default:
+            break;
+    }
+}
+
+static void visit_roots(void (*visit)(object** slot)) {
+    visit(&quote_symbol);
+    visit(&quasiquote_symbol);
+    visit(&unquote_symbol);
+    visit(&unquote_splicing_symbol);
+    visit(&define_symbol);
+    visit(&define_syntax_symbol);
+    visit(&syntax_rules_symbol);
+    visit(&ellipsis_symbol);
+    visit(&set_symbol);
+    visit(&ok_symbol);
+    visit(&if_symbol);
+    visit(&lambda_symbol);
+    visit(&begin_symbol);
+    visit(&cond_symbol);
+    visit(&else_symbol);
+    visit(&let_symbol);
+    visit(&let_star_symbol);
+    visit(&letrec_symbol);
+    visit(&and_symbol);
+    visit(&or_symbol);
+    visit(&unassigned_symbol);
+    visit(&eof_object);
+    visit(&the_empty_environment);
+    visit(&the_global_environment);
+
+    for(size_t i = 0; i < gc_root_count; i++)
+        visit(gc_roots[i]);
+    vm_visit_roots(visit);
+}
+
+static void gc_finalize(object* obj) {
+    if(obj->type == SYMBOL)
+        remove_symbol(obj);
+    if(obj->type == SYMBOL && obj->data.symbol.value != NULL)
+        free(obj->data.symbol.value);
+    if(obj->type == STRING && obj->data.string.value != NULL)
+        free(obj->data.string.value);
+    if(obj->type == PORT &&
+       obj->data.port.file != NULL &&
+       obj->data.port.close_on_gc)
+        fclose(obj->data.port.file);
+    if(obj->type == CONTINUATION)
+        free(obj->data.continuation.point);
+}
+
+/* the bytes from obj to the next object on a nursery page */
+static size_t object_extent(object* obj) {
+    if(obj->type == FILLER)
+        return ((filler*) obj)->size;
+    if(obj->type == FORWARDED)
+        obj = ((forwarded*) obj)->copy;
+    return round_up(object_bytes(obj), 8);
+}
+
+/* minor collection */
+
+static int compare_pages(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t) *(gc_page* const*) a;
+    uintptr_t y = (uintptr_t) *(gc_page* const*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * The words of the C stack that point into the nursery. The objects
+ * they point into stay where they are and young, their page is pinned
+ * for the running minor collection, and the objects kept carry a mark
+ * bit until it is over.
+ */
+static object_stack pinned_words = {NULL, 0, 0};
+
+/* old objects that point to objects kept in the nursery */
+static object_stack young_holders = {NULL, 0, 0};
+static bool holds_young = false;
+
+/* notes a word that points into a nursery page in use, nursery is sorted */
+static void pin_address(char* address) {
+    gc_page* page = gc_page_of(address);
+    size_t low = 0;
+    size_t high = nursery_count;
+
+    while(low < high) {
+        size_t middle = (low + high) / 2;
+        if(nursery[middle] == page) {
+            if(address >= page->cells && address < page->bump)
+                push(&pinned_words, (object*) address);
+            return;
+        }
+        if((uintptr_t) nursery[middle] < (uintptr_t) page)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+}
+
+static int compare_words(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t) *(object* const*) a;
+    uintptr_t y = (uintptr_t) *(object* const*) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* keeps the objects the pinned words point into, walking each page once */
+static void pin_objects(void) {
+    char* cell = NULL;
+
+    qsort(pinned_words.objects, pinned_words.count, sizeof(object*), compare_words);
+    for(size_t i = 0; i < pinned_words.count; i++) {
+        char* address = (char*) pinned_words.objects[i];
+        gc_page* page = gc_page_of(address);
+
+        if(cell == NULL || gc_page_of(cell) != page)
+            cell = page->cells;
+        while(cell + object_extent((object*) cell) <= address)
+            cell += object_extent((object*) cell);
+        if(((object*) cell)->type == FILLER || gc_is_marked((object*) cell))
+            continue;
+        page->pinned = true;
+        set_mark((object*) cell);
+        push(&copied, (object*) cell);
+    }
+    pinned_words.count = 0;
+}
+
+SCANS_STACK
+static void scan_stack_range(void (*visit)(char* word)) {
+    char* here = (char*) &here;
+    char** low = (char**) round_up((uintptr_t) (here < stack_base ? here : stack_base), sizeof(char*));
+    char** high = (char**) (here < stack_base ? stack_base : here);
+
+    for(char** word = low; word < high; word++)
+        visit(*word);
+}
+
+/*
+ * C code may hold objects in locals that are not registered as roots,
+ * so both collections treat every word on the C stack and in the
+ * registers as a possible reference. Needs the stack base.
+ */
+static void scan_stack(void (*visit)(char* word)) {
+    jmp_buf registers;
+
+#ifdef __GNUC__
+    __builtin_unwind_init();
+#endif
+    setjmp(registers);
+    scan_stack_range(visit);
+}
+
+static object* evacuate(object* obj) {
+    size_t size = round_up(object_bytes(obj), 8);
+    object* copy = allocate_old(size);
+
+    memcpy(copy, obj, size);
+    /* the variable sized objects point at their own tail */
+    if(obj->type == VECTOR)
+        copy->data.vector.elements = (object**) ((char*) copy + ((char*) obj->data.vector.elements - (char*) obj));
+    else if(obj->type == CODE)
+        copy->data.code.instructions = (uint32_t*) ((char*) copy + ((char*) obj->data.code.instructions - (char*) obj));
+    else if(obj->type == FRAME)
+        copy->data.frame.values = (object**) ((char*) copy + ((char*) obj->data.frame.values - (char*) obj));
+
+    ((forwarded*) obj)->type = FORWARDED;
+    ((forwarded*) obj)->copy = copy;
+    push(&copied, copy);
+    shade_new(copy);
+    return copy;
+}
+
+static void evacuate_slot(object** slot) {
+    object* obj = *slot;
+
+    if(!gc_is_young(obj))
+        return;
+    if(gc_page_of(obj)->pinned && gc_is_marked(obj))
+        holds_young = true;
+    else if(obj->type == FORWARDED)
+        *slot = ((forwarded*) obj)->copy;
+    else
+        *slot = evacuate(obj);
+}
+
+/* evacuates what obj refers to, an old obj still holding a young
+ * object has to be remembered again */
+static void scan_survivor(object* obj) {
+    holds_young = false;
+    scan_object(obj, evacuate_slot);
+    if(holds_young && !gc_is_young(obj))
+        push(&young_holders, obj);
+}
+
+/*
+ * The objects kept on a pinned page stay young, the space between them
+ * becomes fillers and the page is filled again after the last of them.
+ * They are copied out like any other once the C stack lets go of them.
+ */
+static void release_pinned_page(gc_page* page) {
+    char* end = page->cells;
+    filler* run = NULL;
+
+    for(char* cell = page->cells; cell < page->bump;) {
+        object* obj = (object*) cell;
+        size_t size = object_extent(obj);
+
+        cell += size;
+        if(gc_is_marked(obj)) {
+            end = cell;
+            run = NULL;
+            continue;
+        }
+#ifdef GC_STRESS
+        memset(obj, 0xdb, size);
+#endif
+        if(run != NULL) {
+            run->size += size;
+        }
+        else {
+            run = (filler*) obj;
+            run->type = FILLER;
+            run->size = size;
+        }
+    }
+    memset(page->marks, 0, sizeof(page->marks));
+    page->bump = end;
+    page->pinned = false;
+}
+
+static void minor_collect(void) {
+    size_t kept = 0;
+    size_t left = 0;
+
+    if(nursery_page != NULL)
+        nursery_page->bump = nursery_bump;
+    lazy_sweeps = GC_SWEEP_STEP;
+    qsort(nursery, nursery_count, sizeof(gc_page*), compare_pages);
+    scan_stack(pin_address);
+    pin_objects();
+
+    visit_roots(evacuate_slot);
+    for(size_t i = 0; i < remembered.count; i++) {
+        remembered.objects[i]->gc_remembered = false;
+        scan_survivor(remembered.objects[i]);
+    }
+    remembered.count = 0;
+    while(copied.count > 0)
+        scan_survivor(copied.objects[--copied.count]);
+    for(size_t i = 0; i < young_holders.count; i++)
+        if(!young_holders.objects[i]->gc_remembered)
+            gc_remember(young_holders.objects[i]);
+    young_holders.count = 0;
+
+    for(size_t i = 0; i < finalizable.count; i++) {
+        object* obj = finalizable.objects[i];
+        gc_page* page = gc_page_of(obj);
+        if(!page->young || obj->type == FORWARDED)
+            continue;
+        if(page->pinned && gc_is_marked(obj))
+            finalizable.objects[left++] = obj;
+        else
+            gc_finalize(obj);
+    }
+    finalizable.count = left;
+
+    /* the pinned pages come first, everything else is garbage now */
+    for(size_t i = 0; i < nursery_count; i++) {
+        gc_page* page = nursery[i];
+        if(page->pinned) {
+            release_pinned_page(page);
+            nursery[i] = nursery[kept];
+            nursery[kept++] = page;
+        }
+    }
+    for(size_t i = kept; i < nursery_count; i++) {
+        gc_page* page = nursery[i];
+        if(kept >= GC_NURSERY_PAGES) {
+            free(page);
+            continue;
+        }
+#ifdef GC_STRESS
+        memset(page->cells, 0xdb, (size_t) (page->bump - page->cells));
+#endif
+        page->bump = page->cells;
+        nursery[kept++] = page;
+    }
+    nursery_count = kept;
+    nursery_used = 0;
+    nursery_page = NULL;
+    nursery_bump = NULL;
+    nursery_limit = NULL;
+    minor_collections++;
+}
+
+/* a minor collection, unless the nursery was not allocated from since
+ * the last one */
+static void empty_nursery(void) {
+    if(nursery_page != NULL)
+        minor_collect();
+}
+
+/*
+ * Major collection. Marking is incremental: it starts from the roots
+ * and then scans at most gc_mark_step gray objects per safepoint. The
+ * write barrier shades every old object that is stored while marking,
+ * so an object that is already scanned cannot hide an unmarked one.
+ * Objects promoted or allocated in the old space meanwhile start gray.
+ * Once no gray object is left, a pause empties the nursery and marks
+ * from the roots again, which are not behind the barrier, until that
+ * leaves no gray object either; see finish_marking. The roots include
+ * every old object a word on the C stack points into, as C code keeps
+ * objects in locals it does not register.
+ */
+
+static void shade_slot(object** slot) {
+    gc_shade(*slot);
+}
+
+/* shades the old object that address points into, if there is one */
+static void shade_address(char* address) {
+    page_entry* entry = page_table_find((uintptr_t) address & ~(uintptr_t) (GC_PAGE_SIZE - 1));
+    gc_page* page;
+    char* cell;
+
+    if(entry == NULL)
+        return;
+    page = entry->page;
+    if(address < page->cells || address >= page->bump)
+        return;
+
+    cell = page->cells + (size_t) (address - page->cells) / page->cell_size * page->cell_size;
+    if(((object*) cell)->type != FREE_CELL)
+        gc_shade((object*) cell);
+}
+
+/* right after a minor collection the nursery only holds the objects
+ * the C stack kept there, the old objects they refer to are in use */
+static void shade_nursery(void) {
+    for(size_t i = 0; i < nursery_count; i++) {
+        gc_page* page = nursery[i];
+        for(char* cell = page->cells; cell < page->bump; cell += object_extent((object*) cell))
+            if(((object*) cell)->type != FILLER)
+                scan_object((object*) cell, shade_slot);
+    }
+}
+
+static void shade_roots(void) {
+    visit_roots(shade_slot);
+    mark_global_symbols(gc_shade);
+    scan_stack(shade_address);
+    shade_nursery();
+}
+
+/*
+ * scans up to budget gray objects, true when none is left. The cdr
+ * chain of a list is followed in place, so a long list neither grows
+ * the gray stack nor goes through it once per pair.
+ */
+static bool mark_step(size_t budget) {
+    while(gray.count > 0 && budget > 0) {
+        object* obj = gray.objects[--gray.count];
+
+        for(;;) {
+            budget--;
+            cycle_marked++;
+            if(obj->type != PAIR) {
+                scan_object(obj, shade_slot);
+                break;
+            }
+            gc_shade(obj->data.pair.car);
+            if(!mark(obj->data.pair.cdr))
+                break;
+            obj = obj->data.pair.cdr;
+            if(budget == 0) {
+                push(&gray, obj);
+                break;
+            }
+        }
+    }
+    return gray.count == 0;
+}
+
+/* sweeps one page, returns the bytes still alive, counts the objects in swept */
+static size_t sweep_page(gc_page* page, size_t* swept) {
+    free_cell* free_list = NULL;
+    size_t live = 0;
+
+    page->sweep_epoch = sweep_epoch;
+    for(char* cell = page->cells; cell < page->bump; cell += page->cell_size) {
+        object* obj = (object*) cell;
+
+        if(obj->type != FREE_CELL) {
+            (*swept)++;
+            if(gc_is_marked(obj)) {
+                live++;
+                continue;
+            }
+            gc_finalize(obj);
+#ifdef GC_STRESS
+            memset(cell, 0xdb, page->cell_size);
+#endif
+            obj->type = FREE_CELL;
+        }
+        ((free_cell*) cell)->next = free_list;
+        free_list = (free_cell*) cell;
+    }
+
+    memset(page->marks, 0, sizeof(page->marks));
+    if(live == 0) {
+        /* nothing survived, go back to bump allocation */
+        page->bump = page->cells;
+        page->free_list = NULL;
+    }
+    else {
+        page->free_list = free_list;
+    }
+    return live * page->cell_size;
+}
+
+/*
+ * The sweep is lazy. A page is still to be swept while its epoch is
+ * older than sweep_epoch. Once marking is done, the allocation cursor
+ * of every size class goes back to its first page, and the allocator
+ * sweeps each page when the cursor reaches it, so the pause that ends
+ * the marking sweeps nothing. Between two minor collections it sweeps
+ * GC_SWEEP_STEP pages at most, then it takes fresh pages instead, as
+ * the promotions after a long marking may find a run of full pages.
+ * The pages the allocator has not needed are swept by sweep_step,
+ * GC_SWEEP_STEP pages per safepoint in list order, a size class after
+ * the other, then the large pages. Only sweep_step hands empty pages
+ * back.
+ */
+static size_t sweep_list = 0;
+static gc_page* sweep_prev = NULL;     /* last page kept in the list */
+static bool sweep_kept_empty = false;
+
+static gc_page** sweep_list_head(size_t list) {
+    return list < SIZE_CLASS_COUNT ? &heap_classes[list].pages : &large_pages;
+}
+
+/*
+ * Called for a page of list once it is swept, with prev the last page
+ * kept in front of it. An empty page is unlinked and freed, except for
+ * the allocation cursor and the first empty page of a size class.
+ * Returns whether page stays in the list.
+ */
+static bool keep_page(size_t list, gc_page* prev, gc_page* page, size_t live, bool* kept_empty) {
+    gc_page** head = sweep_list_head(list);
+    size_class* class = list < SIZE_CLASS_COUNT ? &heap_classes[list] : NULL;
+
+    if(live == 0 && (class == NULL || (*kept_empty && page != class->current))) {
+        if(prev == NULL)
+            *head = page->next;
+        else
+            prev->next = page->next;
+        if(class != NULL && class->last == page)
+            class->last = prev;
+        remove_old_page(page);
+        free(page);
+        return false;
+    }
+    if(live == 0)
+        *kept_empty = true;
+    return true;
+}
+
+static void finish_sweeping(void) {
+    gc_sweeping = false;
+    swept_live_bytes = live_bytes;
+    collect_threshold = live_bytes > GC_MIN_BUDGET ? live_bytes : GC_MIN_BUDGET;
+    major_collections++;
+}
+
+static void sweep_lazily(gc_page* page) {
+    double start = report_clock();
+
+    live_bytes += sweep_page(page, &cycle_swept);
+    cycle_sweep_time += report_clock() - start;
+}
+
+static void start_sweeping(void) {
+    for(size_t i = 0; i < SIZE_CLASS_COUNT; i++)
+        heap_classes[i].current = heap_classes[i].pages;
+    sweep_epoch++;
+    sweep_list = 0;
+    sweep_prev = NULL;
+    sweep_kept_empty = false;
+    gc_sweeping = true;
+}
+
+/* sweeps up to budget pages, true when all are swept */
+static bool sweep_step(size_t budget) {
+    while(sweep_list <= SIZE_CLASS_COUNT) {
+        gc_page** head = sweep_list_head(sweep_list);
+        gc_page* page = sweep_prev == NULL ? *head : sweep_prev->next;
+        size_t live;
+
+        if(page == NULL) {
+            sweep_list++;
+            sweep_prev = NULL;
+            sweep_kept_empty = false;
+            continue;
+        }
+        /* swept by the allocator, or added since the marking ended */
+        if(page->sweep_epoch == sweep_epoch) {
+            sweep_prev = page;
+            continue;
+        }
+        if(budget == 0)
+            return false;
+        budget--;
+
+        live = sweep_page(page, &cycle_swept);
+        live_bytes += live;
+        if(keep_page(sweep_list, sweep_prev, page, live, &sweep_kept_empty))
+            sweep_prev = page;
+    }
+
+    finish_sweeping();
+    return true;
+}
+
+/*
+ * Once marking is complete, the old objects that still hold a pinned
+ * nursery object may be dead. They leave the remembered set before the
+ * sweep frees them.
+ */
+static void forget_dead_objects(void) {
+    size_t kept = 0;
+
+    for(size_t i = 0; i < remembered.count; i++) {
+        object* obj = remembered.objects[i];
+        if(gc_is_marked(obj))
+            remembered.objects[kept++] = obj;
+    }
+    remembered.count = kept;
+}
+
+/* attempts to end the running marking, see finish_marking */
+static size_t finish_attempts = 0;
+
+static void start_marking(void) {
+    gc_marking = true;
+    major_pending = false;
+    finish_attempts = 0;
+    shade_roots();
+}
+
+/*
+ * Runs once the gray set is empty, right after a minor collection. The
+ * roots are rescanned, and what that shades gets one more step of
+ * gc_mark_step objects. The mutator has not run since the rescan, so if
+ * that step empties the gray set, marking is complete. Otherwise it
+ * goes on at the next safepoints and the roots are rescanned again
+ * when it runs dry. A mutator that keeps the nursery alive could keep
+ * that going forever, so after GC_FINISH_ATTEMPTS the last attempt
+ * drains the gray set in its pause. Returns whether marking is over.
+ */
+static bool finish_marking(void) {
+    shade_roots();
+    if(++finish_attempts < GC_FINISH_ATTEMPTS) {
+        if(!mark_step(gc_mark_step))
+            return false;
+    }
+    else {
+        mark_step(SIZE_MAX);
+    }
+    gc_marking = false;
+
+    forget_dead_objects();
+    live_bytes = 0;
+    bytes_since_collect = 0;
+    start_sweeping();
+    return true;
+}
+
+/* millions of objects per second */
+static double throughput(size_t objects, double ms) {
+    return ms > 0 ? (double) objects / ms / 1e3 : 0.0;
+}
+
+static void record_pause(double pause, bool finished) {
+    pause_count++;
+    total_pause += pause;
+    if(pause > longest_pause)
+        longest_pause = pause;
+    if(pause > GC_PAUSE_TARGET_MS)
+        pauses_over_target++;
+
+    cycle_pauses++;
+    cycle_total_pause += pause;
+    if(pause > cycle_longest_pause)
+        cycle_longest_pause = pause;
+    if(finished && gc_report_pauses) {
+        fprintf(stderr, "gc: major collection %zu: %zu pauses, longest %.3f ms, total %.3f ms, %zu KB live\n",
+                major_collections, cycle_pauses, cycle_longest_pause, cycle_total_pause, swept_live_bytes / 1024);
+        fprintf(stderr, "gc:   marked %zu objects at %.2f M/s, swept %zu at %.2f M/s\n",
+                cycle_marked, throughput(cycle_marked, cycle_mark_time),
+                cycle_swept, throughput(cycle_swept, cycle_sweep_time));
+    }
+    if(finished) {
+        cycle_pauses = 0;
+        cycle_total_pause = 0;
+        cycle_longest_pause = 0;
+    }
+}
+
+#ifdef GC_PARALLEL
+/*
+ * Parallel collection. The mutator is stopped and the nursery empty, so
+ * marking only has to reach the old objects from the roots. Every thread
+ * marks from a private stack and, while other threads are idle and its
+ * deque has run empty, moves half of that stack into it. The deques
+ * are of the Chase-Lev kind: the owner pushes and pops at the bottom
+ * without locking, the other threads steal from the top once they have
+ * nothing left. The sweep then hands out GC_SWEEP_STEP pages at a
+ * time, and the empty pages are released in list order afterwards.
+ */
+#define DEQUE_SIZE 4096
+
+typedef struct {
+    long top;
+    long bottom;
+    object* slots[DEQUE_SIZE];
+} mark_deque;
+
+typedef struct {
+    pthread_t thread;
+    object_stack local;
+    mark_deque deque;
+    size_t marked;
+    size_t swept;
+} gc_worker;
+
+static gc_worker* workers = NULL;
+static size_t worker_count = 0;
+static void (*worker_task)(gc_worker* worker);
+static __thread gc_worker* current_worker;
+
+static long idle_workers = 0;
+
+static gc_page** sweep_pages = NULL;
+static size_t* sweep_live = NULL;
+static size_t sweep_page_count = 0;
+static size_t sweep_page_capacity = 0;
+static size_t next_sweep_page = 0;
+
+static bool deque_push(mark_deque* deque, object* obj) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+    if(bottom - top >= DEQUE_SIZE)
+        return false;
+    __atomic_store_n(&deque->slots[bottom & (DEQUE_SIZE - 1)], obj, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static object* deque_pop(mark_deque* deque) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    long top;
+    object* obj;
+
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+    if(top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    obj = __atomic_load_n(&deque->slots[bottom & (DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if(top == bottom) {
+        /* the last one, a thief may be taking it as well */
+        if(!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            obj = NULL;
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return obj;
+}
+
+static object* deque_steal(mark_deque* deque) {
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    long bottom;
+    object* obj;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if(top >= bottom)
+        return NULL;
+    obj = __atomic_load_n(&deque->slots[top & (DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if(!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NULL;
+    return obj;
+}
+
+/* mark for several threads at once */
+static bool mark_shared(object* obj) {
+    gc_page* page;
+    uint64_t* word;
+    uint64_t bit;
+
+    if(obj == NULL || is_immediate(obj))
+        return false;
+    page = gc_page_of(obj);
+    word = &page->marks[gc_mark_bit(obj) / 64];
+    bit = (uint64_t) 1 << (gc_mark_bit(obj) % 64);
+    if(page->young || (__atomic_load_n(word, __ATOMIC_RELAXED) & bit) != 0)
+        return false;
+    return (__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit) == 0;
+}
+
+static bool deque_empty(mark_deque* deque) {
+    return __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE) >=
+           __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+}
+
+/* lets the other threads steal half of the private stack */
+static void share_work(gc_worker* worker) {
+    size_t keep = worker->local.count / 2;
+
+    while(worker->local.count > keep &&
+          deque_push(&worker->deque, worker->local.objects[worker->local.count - 1]))
+        worker->local.count--;
+}
+
+static void shade_shared_slot(object** slot) {
+    if(mark_shared(*slot))
+        push(&current_worker->local, *slot);
+}
+
+/* scans a gray object, following the cdr chain like mark_step */
+static void scan_shared(gc_worker* worker, object* obj) {
+    for(;;) {
+        worker->marked++;
+        if(obj->type != PAIR) {
+            scan_object(obj, shade_shared_slot);
+            return;
+        }
+        if(mark_shared(obj->data.pair.car))
+            push(&worker->local, obj->data.pair.car);
+        if(!mark_shared(obj->data.pair.cdr))
+            return;
+        obj = obj->data.pair.cdr;
+    }
+}
+
+static object* find_work(gc_worker* worker) {
+    object* obj;
+
+    if(worker->local.count > 0) {
+        if(worker->local.count > 1 && __atomic_load_n(&idle_workers, __ATOMIC_RELAXED) > 0 &&
+           deque_empty(&worker->deque))
+            share_work(worker);
+        return worker->local.objects[--worker->local.count];
+    }
+    obj = deque_pop(&worker->deque);
+    if(obj != NULL)
+        return obj;
+    for(size_t i = 1; i < worker_count; i++) {
+        gc_worker* victim = &workers[((size_t) (worker - workers) + i) % worker_count];
+        obj = deque_steal(&victim->deque);
+        if(obj != NULL)
+            return obj;
+    }
+    return NULL;
+}
+
+static bool work_left(void) {
+    for(size_t i = 0; i < worker_count; i++) {
+        if(!deque_empty(&workers[i].deque))
+            return true;
+    }
+    return false;
+}
+
+/* marking is over once every thread is idle, none can make new work then */
+static void mark_in_parallel(gc_worker* worker) {
+    for(;;) {
+        object* obj = find_work(worker);
+
+        if(obj != NULL) {
+            scan_shared(worker, obj);
+            continue;
+        }
+        __atomic_add_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+        for(;;) {
+            if(__atomic_load_n(&idle_workers, __ATOMIC_SEQ_CST) == (long) worker_count)
+                return;
+            if(work_left()) {
+                __atomic_sub_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+static void sweep_in_parallel(gc_worker* worker) {
+    for(;;) {
+        size_t first = __atomic_fetch_add(&next_sweep_page, GC_SWEEP_STEP, __ATOMIC_RELAXED);
+
+        if(first >= sweep_page_count)
+            return;
+        for(size_t i = first; i < first + GC_SWEEP_STEP && i < sweep_page_count; i++)
+            sweep_live[i] = sweep_page(sweep_pages[i], &worker->swept);
+    }
+}
+
+static void* worker_main(void* argument) {
+    current_worker = (gc_worker*) argument;
+    worker_task(current_worker);
+    return NULL;
+}
+
+/* runs task on every worker, the first one on this thread */
+static void run_workers(void (*task)(gc_worker* worker)) {
+    worker_task = task;
+    for(size_t i = 1; i < worker_count; i++) {
+        if(pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0)
+            error_handle(stderr, "cannot start a collector thread", EXIT_FAILURE);
+    }
+    current_worker = &workers[0];
+    task(&workers[0]);
+    for(size_t i = 1; i < worker_count; i++)
+        pthread_join(workers[i].thread, NULL);
+}
+
+static void add_sweep_page(gc_page* page) {
+    if(sweep_page_count == sweep_page_capacity) {
+        size_t capacity = sweep_page_capacity;
+        sweep_pages = (gc_page**) grow_array(sweep_pages, &sweep_page_capacity, sizeof(gc_page*));
+        sweep_live = (size_t*) grow_array(sweep_live, &capacity, sizeof(size_t));
+    }
+    sweep_pages[sweep_page_count++] = page;
+}
+
+/* a whole major collection in this pause, runs after a minor collection */
+static void collect_in_parallel(void) {
+    double phase = report_clock();
+    size_t next = 0;
+
+    if(workers == NULL) {
+        worker_count = gc_threads;
+        workers = (gc_worker*) calloc(worker_count, sizeof(gc_worker));
+        if(workers == NULL)
+            error_handle(stderr, "out of memory", EXIT_FAILURE);
+    }
+    major_pending = false;
+
+    shade_roots();
+    while(gray.count > 0)
+        push(&workers[next++ % worker_count].local, gray.objects[--gray.count]);
+    idle_workers = 0;
+    run_workers(mark_in_parallel);
+    for(size_t i = 0; i < worker_count; i++) {
+        cycle_marked += workers[i].marked;
+        workers[i].marked = 0;
+    }
+    forget_dead_objects();
+    sweep_symbol_table();
+    cycle_mark_time += report_clock() - phase;
+
+    phase = report_clock();
+    live_bytes = 0;
+    bytes_since_collect = 0;
+    sweep_epoch++;
+    sweep_page_count = 0;
+    for(size_t list = 0; list <= SIZE_CLASS_COUNT; list++) {
+        for(gc_page* page = *sweep_list_head(list); page != NULL; page = page->next)
+            add_sweep_page(page);
+    }
+    next_sweep_page = 0;
+    run_workers(sweep_in_parallel);
+    for(size_t i = 0; i < worker_count; i++) {
+        cycle_swept += workers[i].swept;
+        workers[i].swept = 0;
+    }
+
+    /* the pages are in list order */
+    next = 0;
+    for(size_t list = 0; list <= SIZE_CLASS_COUNT; list++) {
+        gc_page* prev = NULL;
+        gc_page* page = *sweep_list_head(list);
+        bool kept_empty = false;
+
+        while(page != NULL) {
+            gc_page* following = page->next;
+            size_t live = sweep_live[next++];
+
+            live_bytes += live;
+            if(keep_page(list, prev, page, live, &kept_empty))
+                prev = page;
+            page = following;
+        }
+        if(list < SIZE_CLASS_COUNT)
+            heap_classes[list].current = heap_classes[list].pages;
+    }
+    finish_sweeping();
+    cycle_sweep_time += report_clock() - phase;
+}
+
+/* parallel collection pays off on big heaps only */
+static bool collect_in_parallel_now(void) {
+    return gc_threads > 1 && swept_live_bytes + bytes_since_collect >= GC_PARALLEL_MIN_HEAP;
+}
+#else
+/* without threads every major collection is incremental */
+static bool collect_in_parallel_now(void) {
+    return false;
+}
+
+static void collect_in_parallel(void) {
+}
+#endif
+
+void gc_collect(void) {
+    double start = now_ms();
+    double phase;
+    bool finished = false;
+
+    /* without the stack base, objects held by C locals cannot be found
+     * and the nursery just grows */
+    if(stack_base == NULL) {
+        gc_pending = false;
+        return;
+    }
+#ifdef GC_STRESS
+    if(!gc_pending && stress_skips > 0) {
+        stress_skips--;
+        return;
+    }
+    stress_skips = 0;
+    if(vm_stack_top > GC_STRESS_SMALL_STACK)
+        stress_skips += (vm_stack_top - GC_STRESS_SMALL_STACK) / GC_STRESS_STACK_SLOTS;
+    if(swept_live_bytes + bytes_since_collect > GC_STRESS_SMALL_HEAP)
+        stress_skips += (swept_live_bytes + bytes_since_collect - GC_STRESS_SMALL_HEAP) / GC_STRESS_HEAP_BYTES;
+    major_pending = true;
+    minor_collect();
+#else
+    if(nursery_used >= GC_NURSERY_PAGES)
+        minor_collect();
+#endif
+    if(gc_sweeping) {
+        phase = report_clock();
+        finished = sweep_step(GC_SWEEP_STEP);
+        cycle_sweep_time += report_clock() - phase;
+    }
+    else if(!gc_marking && major_pending) {
+        /* with the nursery empty but for what the C stack holds, everything
+         * in use is reachable from the roots */
+        empty_nursery();
+        if(collect_in_parallel_now()) {
+            collect_in_parallel();
+            finished = true;
+        }
+        else {
+            start_marking();
+        }
+    }
+    if(gc_marking) {
+        bool done;
+
+        phase = report_clock();
+        done = mark_step(gc_mark_step);
+        cycle_mark_time += report_clock() - phase;
+        if(done) {
+            empty_nursery();
+            phase = report_clock();
+            finish_marking();
+            cycle_mark_time += report_clock() - phase;
+        }
+    }
+    gc_pending = false;
+
+    record_pause(now_ms() - start, finished);
+    if(finished) {
+        objects_marked += cycle_marked;
+        objects_swept += cycle_swept;
+        mark_time += cycle_mark_time;
+        sweep_time += cycle_sweep_time;
+        cycle_marked = 0;
+        cycle_swept = 0;
+        cycle_mark_time = 0;
+        cycle_sweep_time = 0;
+    }
+}
+
+size_t gc_pauses(void) {
+    return pause_count;
+}
+
+size_t gc_pauses_over_target(void) {
+    return pauses_over_target;
+}
+
+void gc_report(void) {
+    fprintf(stderr, "gc: %zu minor and %zu major collections, %zu pauses, "
+                    "longest %.3f ms, mean %.3f ms, %zu over %d ms\n",
+            minor_collections, major_collections, pause_count, longest_pause,
+            pause_count == 0 ? 0.0 : total_pause / (double) pause_count,
+            pauses_over_target, GC_PAUSE_TARGET_MS);
+    fprintf(stderr, "gc: marked %zu objects at %.2f M/s, swept %zu at %.2f M/s\n",
+            objects_marked, throughput(objects_marked, mark_time),
+            objects_swept, throughput(objects_swept, sweep_time));
+}
@@ -0,0 +1,79 @@
+//
+// syntactic analysis of expressions into executable syntax nodes
+//
+
+#ifndef SCHEME_ANALYZE_H
+#define SCHEME_ANALYZE_H
+
+#include "object.h"
+
+/*
+ * analyze walks an expression once and turns it into a tree of NODE
+ * objects, as in SICP 4.1.7. Derived forms (cond, let, let*, letrec)
+ * are rewritten during analysis, so executing a node never looks at
+ * the source syntax again. The three operand slots of a node hold:
+ *
+ *   kind                   first        second        third
+ *   NODE_CONSTANT          value
+ *   NODE_VARIABLE          symbol
+ *   NODE_LOCAL_VARIABLE    symbol                     lexical address
+ *   NODE_QUASIQUOTE        template with analyzed unquotes
+ *   NODE_ASSIGNMENT        symbol       value node
+ *   NODE_LOCAL_ASSIGNMENT  symbol       value node    lexical address
+ *   NODE_DEFINITION        symbol       value node
+ *   NODE_LOCAL_DEFINITION  symbol       value node    lexical address
+ *   NODE_DEFINE_SYNTAX     form
+ *   NODE_IF                predicate    consequent    alternative
+ *   NODE_LAMBDA            parameters   body node     closure layout**
+ *   NODE_SEQUENCE          vector of nodes
+ *   NODE_AND / NODE_OR     vector of nodes
+ *   NODE_APPLICATION       operator     operands*     (form . scope)
+ *   NODE_ERROR             message
+ *   NODE_INVALID           form
+ *
+ * (*) see application_operands.
+ * (**) the slot names, the slots to box and the variables to capture,
+ *      see make_closure.
+ *
+ * Variables bound by an enclosing lambda, including the names its body
+ * defines, are resolved to lexical addresses (see environment.h). Each
+ * lambda captures the ones its body, or a lambda in it, uses from the
+ * procedures around it. The other variables are looked up by name at
+ * the top level.
+ *
+ * Macro uses cannot be told apart from applications before the operator
+ * is known, so an application node expands and analyzes its form in the
+ * scope it was found in when the operator turns out to be a macro. The
+ * result is kept in the expansion slot of the node together with the
+ * macro, and reused for as long as the operator is that same macro.
+ * Uses of a macro that is defined at the top level by the time the form
+ * is analyzed are expanded during analysis already, so a loaded file is
+ * expanded form by form before it runs.
+ */
+extern object* analyze(object* exp);
+
+/* analyzes exp in the given scope, a list of the names of the frames
+ * around it, innermost first */
+extern object* analyze_in_scope(object* exp, object* scope);
+
+extern bool is_variable_node(object* node);
+
+/* the analyzed expansion of the application node whose operator
+ * evaluated to macro */
+extern object* macro_expansion(object* node, object* macro);
+
+/* the operand nodes of an application, analyzed on first use for a
+ * macro use expanded during analysis */
+extern object* application_operands(object* node);
+
+/* the procedure of a lambda node, capturing its free variables from env */
+extern object* make_closure(object* lambda, object* env);
+
+/*
+ * runs a node, tail positions are executed in a loop, not recursively;
+ * other calls still recurse on the C stack, so deep recursion can
+ * overflow it
+ */
+extern object* execute(object* node, object* env);
+
+#endif //SCHEME_ANALYZE_H
@@ -41,14 +41,47 @@
 
 extern void init_built_in();
 
-extern object* make_compound_procedure(object* parameters, object* body, object* env);
+extern object* make_compound_procedure(object* parameters, object* variables, object* boxed,
+                                       object* body, object* env);
 
 extern object* make_primitive_procedure(object* (* fun)(object* ));
 
+/*
+ * Primitives taking their arguments as a count and an array can be
+ * called straight from the VM stack or a C array, without building an
+ * argument list. They must not reach a GC safepoint, as nothing else
+ * keeps argv alive while they run.
+ *
+ * Their arity is checked once by the caller, so argv_fun may assume
+ * min_args <= argc <= max_args. binary_fun, if not NULL, is called
+ * instead when there are exactly two arguments.
+ */
+extern object* make_argv_primitive_procedure(const char* name, size_t min_args, size_t max_args,
+                                             object* (* argv_fun)(size_t argc, object** argv),
+                                             object* (* binary_fun)(object* first, object* second));
+
+#define PRIMITIVE_VARIADIC SIZE_MAX
+
+#define primitive_arity_ok(procedure, argc) \
+    ((argc) >= (procedure)->data.primitive_proc.min_args && \
+     (argc) <= (procedure)->data.primitive_proc.max_args)
+
+extern void primitive_arity_error(object* procedure, size_t argc);
+
+/* calls a primitive of either kind with an argument list */
+extern object* apply_primitive_procedure(object* procedure, object* arguments);
+
+/* argument arrays up to this size live on the C stack */
+#define PRIMITIVE_ARGV_INLINE 8
+
 extern object* make_environment();
 
 extern object* setup_environment();
 
 extern void    add_primitive_to_environment(object* env);
 
+/* the next argument list of map and for-each, taken from the front of
+ * each list in lists, or NULL once the lists are exhausted */
+extern object* next_map_arguments(const char* proc_name, object* lists);
+
 #endif //SCHEME_BUILTIN_H
@@ -7,23 +7,68 @@
 
 #include "object.h"
 
+/*
+ * An environment is a chain of FRAME objects ending in the empty list.
+ * A frame has one slot for every name its procedure binds, named by the
+ * variables vector, and an alist for names defined later by eval. The
+ * frame at the bottom is the top level, whose bindings are kept in the
+ * global_value cell of each symbol so that finding one takes no search.
+ *
+ * Closures are flat: instead of the whole environment they were created
+ * in, they keep a frame with a copy of just the variables their body
+ * uses, whose parent is the top level. The frame of a call therefore
+ * has the closure frame above it and the top level above that. Local
+ * variables that are captured and may change after the capture, by
+ * set! or because they are internal definitions, are kept in a BOX in
+ * every frame holding them, and accessed through it.
+ *
+ * A lexical address locates a local variable without looking at names:
+ * depth 0 for a slot of the frame of the call, depth 1 for one of the
+ * closure frame, and the slot. analyze computes them, the frames created
+ * by extend_procedure_environment and capture_variables provide the
+ * slots.
+ */
+#define LEXICAL_DEPTH_SHIFT 16
+#define LEXICAL_SLOT_MASK   ((1L << LEXICAL_DEPTH_SHIFT) - 1)
+#define make_lexical_address(depth, slot) (((long)(depth) << LEXICAL_DEPTH_SHIFT) | (long)(slot))
+#define lexical_depth(address) ((size_t) ((address) >> LEXICAL_DEPTH_SHIFT))
+#define lexical_slot(address)  ((size_t) ((address) & LEXICAL_SLOT_MASK))
+
+/* set once a definition that adds a name to the frame of a procedure
+ * call is analyzed, which lexical addresses cannot know about */
+extern bool frames_extended;
+
 extern object* lookup_variable_value(object* var, object* env);
 
-extern object* extend_environment(object* variables, object* values, object* base_env);
+extern object* lookup_lexical_value(object* var, long address, object* env);
 
-extern void    set_variable_value(object* var, object* value, object* env);
+extern void    set_lexical_value(object* var, long address, object* value, object* env);
 
-extern void    define_variable(object* var, object* val, object* env);
+extern void    define_lexical_value(long address, object* value, object* env);
 
-extern object* enclosing_environment(object* env);
+/* variables that are not lexically bound, looked up by name at the top
+ * level, or from env once frames_extended is set */
+extern object* lookup_global_value(object* var, object* env);
+
+extern void    set_global_value(object* var, object* value, object* env);
 
-extern object* first_frame(object* env);
+/* the environment of a closure capturing the variables names, found in
+ * env at the lexical addresses in the vector addresses, on top of env
+ * itself when keep_env is set */
+extern object* capture_variables(object* names, object* addresses, bool keep_env, object* env);
 
-extern object* make_frame(object* variables, object* values);
+/* the value var is bound to at the top level, NULL when unbound */
+extern object* top_level_value(object* var);
 
-extern object* frame_variables(object* frame);
+extern object* extend_procedure_environment(object* procedure, object* arguments);
 
-extern object* frame_values(object* frame);
+extern object* extend_procedure_environment_argv(object* procedure, size_t argc, object** argv);
 
-extern void add_binding_to_frame(object* var, object* val, object* frame);
+extern object* extend_environment(object* variables, object* values, object* base_env);
+
+extern void    set_variable_value(object* var, object* value, object* env);
+
+extern void    define_variable(object* var, object* val, object* env);
+
+extern object* enclosing_environment(object* env);
 #endif //SCHEME_ENVIRONMENT_H
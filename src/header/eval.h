@@ -16,10 +16,14 @@ extern bool is_variable       (object* exp);
 
 extern bool is_quoted         (object* exp);
 
+extern bool is_quasiquote     (object* exp);
+
 extern bool is_assignment     (object* exp);
 
 extern bool is_definition     (object* exp);
 
+extern bool is_define_syntax  (object* exp);
+
 extern bool is_if             (object* exp);
 
 extern bool is_lambda         (object* exp);
@@ -46,28 +50,21 @@ extern bool is_tagged_list    (object* exp, object* tag);
 
 extern object* text_of_quotation(object* exp);
 
-extern object* eval_assignment(object* exp, object* env);
-
-extern object* eval_definition(object* exp, object* env);
-
-extern object* eval_if(object* exp, object* env);
+extern object* eval_define_syntax(object* exp, object* env);
 
-extern object* make_procedure(object* parameters, object* body, object* env);
+extern object* make_procedure(object* parameters, object* variables, object* boxed,
+                              object* body, object* env);
 
 extern object* lambda_parameters(object* exp);
 
 extern object* lambda_body(object* exp);
 
-extern object* eval_sequence(object* exp, object* env);
-
 extern object* begin_actions(object* exp);
 
 extern object* operator(object* exp);
 
 extern object* operands(object* exp);
 
-extern object* list_of_values(object* exps, object* env);
-
 extern bool    is_last_exp(object* seq);
 
 extern object* first_exp(object* seq);
@@ -142,4 +139,7 @@ extern object* and_tests(object* exp);
 
 extern object* or_tests(object* exp);
 
+/* template is the output of analyze, its unquoted parts are nodes */
+extern object* eval_quasiquote(object* template_exp, object* env, int depth);
+
 #endif //SCHEME_EVAL_H
@@ -0,0 +1,223 @@
+//
+// page based object heap and generational collector
+//
+
+#ifndef SCHEME_GC_H
+#define SCHEME_GC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object.h"
+
+/*
+ * The heap is made of GC_PAGE_SIZE aligned pages. Every page serves a
+ * single size class: cells are handed out with a bump pointer first and
+ * recycled through a per page free list once the page has been swept.
+ * Objects larger than the biggest size class get a page of their own.
+ */
+#define GC_PAGE_SIZE (16 * 1024)
+
+/*
+ * Mark bits live in a bitmap in the page header, one bit per
+ * GC_MARK_GRANULE bytes, rather than in the objects: marking writes to
+ * a few header lines instead of every object, and the sweep clears a
+ * page with one memset. Objects start at least a granule apart.
+ */
+#define GC_MARK_GRANULE 8
+#define GC_MARK_WORDS   (GC_PAGE_SIZE / GC_MARK_GRANULE / 64)
+
+/*
+ * Generations. Small objects are bump allocated in the nursery, a run of
+ * GC_NURSERY_PAGES pages that has no size classes. Filling it up
+ * requests a minor collection, which copies the nursery objects that
+ * are still reachable into the size class pages, the old space, and
+ * then reuses the nursery as a whole, so its cost follows the young
+ * data that survives rather than the size of the heap. That copy is a
+ * pause, which keeps the nursery small. The old space is marked and
+ * swept once it grew by its budget. Symbols and objects larger than a
+ * cell are allocated in the old space right away.
+ *
+ * A minor collection starts from the precise roots, the old objects in
+ * the remembered set and the C stack. C code may keep objects in plain
+ * locals, so nothing the C stack refers to is moved: an object that a
+ * word on the stack points into stays young and in place, its page is
+ * pinned. The other objects of that page are copied or dead as usual,
+ * and the page is filled again after the last object kept. For the same
+ * reason, a major collection marks every old object that the C stack
+ * points into.
+ */
+#define GC_NURSERY_PAGES 32
+
+typedef struct gc_page {
+    struct gc_page* next;
+    size_t cell_size;      /* 0 on nursery pages */
+    char* cells;           /* first cell */
+    char* bump;            /* first never used cell */
+    char* limit;           /* end of the usable area */
+    struct free_cell* free_list;
+    bool young;            /* a nursery page */
+    bool pinned;           /* keeps objects of the running minor collection */
+    unsigned sweep_epoch;  /* the last major collection that swept it */
+    uint64_t marks[GC_MARK_WORDS];
+} gc_page;
+
+/* objects never cross the page they start in */
+#define gc_page_of(obj) \
+    ((gc_page*) ((uintptr_t) (obj) & ~(uintptr_t) (GC_PAGE_SIZE - 1)))
+
+#define gc_is_young(obj) \
+    ((obj) != NULL && !is_immediate(obj) && gc_page_of(obj)->young)
+
+#define gc_mark_bit(obj) \
+    (((uintptr_t) (obj) & (GC_PAGE_SIZE - 1)) / GC_MARK_GRANULE)
+
+/* set once marking reached obj, cleared again by the sweep */
+#define gc_is_marked(obj) \
+    ((gc_page_of(obj)->marks[gc_mark_bit(obj) / 64] >> (gc_mark_bit(obj) % 64)) & 1)
+
+/*
+ * The old space is collected incrementally: every nursery page that is
+ * allocated while a major collection is under way is paid for with a
+ * step at the next safepoint, which scans up to gc_mark_step gray
+ * objects, GC_MAX_MARK_STEP at most. Marking ends in a step that
+ * rescans the roots and then runs out of gray objects; after
+ * GC_FINISH_ATTEMPTS tries the last one drains the gray set whatever it
+ * takes. After marking, the allocator sweeps each page before it
+ * allocates from it, up to GC_SWEEP_STEP pages between two minor
+ * collections, and a step sweeps up to GC_SWEEP_STEP of the pages that
+ * are left. Pauses longer than GC_PAUSE_TARGET_MS are counted in the
+ * statistics. None of these steps grows with the heap, but the rescans
+ * and every minor collection go through the whole VM stack.
+ */
+#define GC_MARK_STEP       4096
+#define GC_MAX_MARK_STEP   (1024 * 1024)
+#define GC_SWEEP_STEP      8
+#define GC_FINISH_ATTEMPTS 16
+#define GC_PAUSE_TARGET_MS 5
+
+extern bool gc_marking;
+extern bool gc_sweeping;
+extern size_t gc_mark_step;
+
+/*
+ * With gc_threads above one, a major collection of an old space larger
+ * than GC_PARALLEL_MIN_HEAP is not incremental: it marks and sweeps in
+ * a single pause on that many threads. This needs POSIX threads and the
+ * GCC atomic builtins.
+ */
+#define GC_PARALLEL_MIN_HEAP (16 * 1024 * 1024)
+#define GC_MAX_THREADS       64
+
+#ifdef __GNUC__
+#define GC_PARALLEL
+#endif
+
+extern size_t gc_threads;
+
+/* prints the pauses and the mark and sweep throughput of every major
+ * collection and, from gc_report, of all of them */
+extern bool gc_report_pauses;
+
+extern void gc_report(void);
+
+/* the collector pauses so far, and those that took longer than
+ * GC_PAUSE_TARGET_MS */
+extern size_t gc_pauses(void);
+extern size_t gc_pauses_over_target(void);
+
+/*
+ * Every store of a reference into an object that may be old has to be
+ * followed by gc_write_barrier. It adds the object to the remembered set
+ * when it now points into the nursery, and while marking it shades the
+ * stored object, so that it is marked even if the object it was stored
+ * into has been scanned already. Objects allocated since the last
+ * safepoint are young or remembered, and gray while marking, so their
+ * initialization needs no barrier.
+ */
+#define gc_write_barrier(owner, value) \
+    do { \
+        if(gc_is_young(value)) { \
+            if(!gc_is_young(owner) && !(owner)->gc_remembered) \
+                gc_remember(owner); \
+        } \
+        else if(gc_marking) \
+            gc_shade(value); \
+    } while(0)
+
+extern void gc_remember(object* obj);
+
+/* marks an old object gray */
+extern void gc_shade(object* obj);
+
+/* obj, which the last marking may have found dead, is in use again, as
+ * when the symbol table hands out a symbol it still holds */
+extern void gc_revive(object* obj);
+
+/* a major collection is started once the old space grew by as many
+ * bytes as the last one found live, promoted or allocated there, but
+ * by no less than GC_MIN_BUDGET */
+#define GC_MIN_BUDGET (4 * 1024 * 1024)
+
+extern object* gc_allocate(size_t size);
+
+/* allocates in the old space, for objects that must never move */
+extern object* gc_allocate_tenured(size_t size);
+
+/* obj owns memory outside the heap that is freed when it dies */
+extern void gc_track_finalizer(object* obj);
+
+/* the C stack is scanned from the collector up to this address */
+extern void gc_set_stack_base(void* base);
+
+/* charges memory that objects hold outside the heap to the budget */
+extern void gc_account(size_t size);
+
+extern void gc_collect(void);
+
+/*
+ * Precise roots. The collector only runs at safepoints, so C code has
+ * to register every local object that is still needed after a call
+ * which can reach a safepoint (eval, apply and everything that calls
+ * them). gc_protect records the address of the variable, so later
+ * assignments to it are seen as well; gc_unprotect drops the most
+ * recently registered variables.
+ */
+extern object*** gc_roots;
+extern size_t gc_root_count;
+extern size_t gc_root_capacity;
+extern bool gc_pending;
+
+extern void gc_grow_roots(void);
+
+#define gc_protect(var) \
+    do { \
+        if(gc_root_count == gc_root_capacity) \
+            gc_grow_roots(); \
+        gc_roots[gc_root_count++] = &(var); \
+    } while(0)
+
+#define gc_unprotect(count) (gc_root_count -= (count))
+
+/*
+ * build with -DGC_STRESS to collect at every safepoint. Every collection
+ * rescans the VM stack and a parallel one the whole old space, so past
+ * GC_STRESS_SMALL_STACK slots and GC_STRESS_SMALL_HEAP bytes the
+ * collections are spaced out: a safepoint more is skipped for every
+ * GC_STRESS_STACK_SLOTS slots and GC_STRESS_HEAP_BYTES bytes above that.
+ */
+#define GC_STRESS_SMALL_STACK 4096
+#define GC_STRESS_STACK_SLOTS 64
+#define GC_STRESS_SMALL_HEAP  (256 * 1024)
+#define GC_STRESS_HEAP_BYTES  (4 * 1024)
+
+#ifdef GC_STRESS
+#define gc_safepoint() gc_collect()
+#else
+#define gc_safepoint() \
+    do { \
+        if(gc_pending) \
+            gc_collect(); \
+    } while(0)
+#endif
+
+#endif //SCHEME_GC_H
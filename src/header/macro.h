@@ -0,0 +1,24 @@
+//
+// syntax-rules macros
+//
+
+#ifndef SCHEME_MACRO_H
+#define SCHEME_MACRO_H
+
+#include "object.h"
+
+/*
+ * define-syntax compiles every rule of a syntax-rules transformer once:
+ * the pattern becomes a matcher that stores what it matches in numbered
+ * slots and the template a builder that reads them back. Pattern
+ * variables may be followed by any number of nested ellipses. The rules
+ * kept in the MACRO object are the compiled ones.
+ */
+extern object* compile_syntax_rules(object* literals, object* rules);
+
+extern object* expand_macro_application(object* macro, object* form);
+
+/* the same, but NULL when no rule matches form */
+extern object* try_expand_macro_application(object* macro, object* form);
+
+#endif //SCHEME_MACRO_H
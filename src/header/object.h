@@ -7,42 +7,106 @@
 #define SCHEME_OBJECT_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
 #include <stdio.h>
 #include <setjmp.h>
 
 typedef enum {THE_EMPTY_LIST, BOOLEAN, SYMBOL,
               FIXNUM, CHARACTER, STRING, PAIR,
               VECTOR, PORT, MACRO, CONTINUATION,
-              PRIMITIVE_PROC, COMPOUND_PROC}
+              PRIMITIVE_PROC, COMPOUND_PROC, NODE, CODE, FRAME, BOX}
               object_type;
 
+/* kinds of the syntax nodes built by analyze, see analyze.h */
+typedef enum {NODE_CONSTANT, NODE_VARIABLE, NODE_LOCAL_VARIABLE,
+              NODE_QUASIQUOTE, NODE_ASSIGNMENT, NODE_LOCAL_ASSIGNMENT,
+              NODE_DEFINITION, NODE_LOCAL_DEFINITION, NODE_DEFINE_SYNTAX,
+              NODE_IF, NODE_LAMBDA, NODE_SEQUENCE, NODE_AND, NODE_OR,
+              NODE_APPLICATION, NODE_ERROR, NODE_INVALID}
+              node_kind;
+
+/*
+ * Small values never live on the heap, they are encoded in the object
+ * pointer itself. Heap objects are at least 8-byte aligned, so the low
+ * bits of a real pointer are always zero:
+ *
+ *   ........vvvvvvv1   fixnum, value in the upper 63 bits
+ *   vvvvvvvvttttt010   immediate of type t with an 8-bit-shifted payload
+ *   ...........xx000   pointer to a heap object
+ *
+ * Fixnums that do not fit in 63 bits fall back to a boxed FIXNUM object.
+ */
+#define FIXNUM_TAG            0x1
+#define IMMEDIATE_TAG         0x2
+#define IMMEDIATE_TAG_MASK    0x7
+#define IMMEDIATE_TYPE_SHIFT  3
+#define IMMEDIATE_TYPE_MASK   0x1f
+#define IMMEDIATE_VALUE_SHIFT 8
+
+#define FIXNUM_MAX (LONG_MAX >> 1)
+#define FIXNUM_MIN (LONG_MIN >> 1)
+
+#define make_immediate(type, value) \
+    ((struct object*) (((uintptr_t)(value) << IMMEDIATE_VALUE_SHIFT) | \
+                       ((uintptr_t)(type) << IMMEDIATE_TYPE_SHIFT) | IMMEDIATE_TAG))
+
+#define is_fixnum_immediate(obj) (((uintptr_t)(obj) & FIXNUM_TAG) != 0)
+#define is_immediate(obj)        (((uintptr_t)(obj) & IMMEDIATE_TAG_MASK) != 0)
+#define are_fixnum_immediates(a, b) \
+    (((uintptr_t)(a) & (uintptr_t)(b) & FIXNUM_TAG) != 0)
+#define fixnum_immediate_value(obj) ((long) ((intptr_t)(obj) >> 1))
+#define immediate_type(obj) \
+    ((object_type) (((uintptr_t)(obj) >> IMMEDIATE_TYPE_SHIFT) & IMMEDIATE_TYPE_MASK))
+#define immediate_value(obj)     ((uintptr_t)(obj) >> IMMEDIATE_VALUE_SHIFT)
+
+#define TRUE_VALUE       make_immediate(BOOLEAN, 1)
+#define FALSE_VALUE      make_immediate(BOOLEAN, 0)
+#define EMPTY_LIST_VALUE make_immediate(THE_EMPTY_LIST, 0)
+
+/* setjmp state of a continuation, kept out of line because a jmp_buf
+ * alone is larger than every other object payload */
+struct vm_run;
+
+typedef struct continuation_point {
+    jmp_buf return_point;
+    size_t root_count;     /* gc root stack height at capture */
+    struct vm_run* run;    /* VM invocation that owns the frame, or NULL */
+    size_t frame;          /* VM frame pointer while active */
+    size_t height;         /* VM stack slots above the entry frame it restores */
+    bool active;
+} continuation_point;
+
+/*
+ * Every heap object starts with the type header followed by the payload
+ * of its own variant. alloc_object only allocates the header plus the
+ * payload that belongs to the requested type, so a pair costs two words
+ * plus the header rather than the size of the largest union member.
+ */
 typedef struct object {
     object_type type;
-    bool gc_marked;
-    struct object* gc_next;
+    bool gc_remembered;    /* old object in the remembered set, see gc.h */
     union {
-        struct {
-            bool value;
-        } boolean;
         struct {
             char* value;
+            unsigned long hash;
+            struct object* global_value;   /* top level binding, or NULL */
         } symbol;
         struct {
             long value;
         } fixnum;
         struct {
-            char value;
-        } character;
-        struct {
-            char* value;
+            char* value;           /* NUL terminated, may also hold NULs */
+            size_t length;
+            size_t capacity;       /* bytes available before the final NUL */
         } string;
         struct {
             struct object* car;
             struct object* cdr;
         } pair;
         struct {
-            struct object* elements;
             size_t length;
+            struct object** elements;   /* stored right behind the header */
         } vector;
         struct {
             FILE* file;
@@ -56,22 +120,70 @@ typedef struct object {
             struct object* env;
         } macro;
         struct {
-            jmp_buf return_point;
-            bool active;
+            continuation_point* point;
             struct object* value;
+            /* VM copy of the stack: frames holds the slots above the
+             * ones shared with parent, NULL for the tree walker */
+            struct object* parent;
+            struct object* frames;
         } continuation;
         struct {
+            /* exactly one of fun and argv_fun is set, see
+             * apply_primitive_procedure */
             struct object* (*fun) (struct object* argument);
+            struct object* (*argv_fun) (size_t argc, struct object** argv);
+            /* optional, called instead of argv_fun with two arguments */
+            struct object* (*binary_fun) (struct object* first, struct object* second);
+            const char* name;
+            size_t min_args;           /* checked by the caller */
+            size_t max_args;           /* PRIMITIVE_VARIADIC when unbounded */
         } primitive_proc;
         struct {
             struct object* parameters;
-            struct object* body;
-            struct object* env;
+            struct object* variables;  /* vector, names of the frame slots */
+            struct object* body;       /* analyzed body, a syntax node */
+            struct object* env;        /* the captured variables */
+            struct object* boxed;      /* vector of the slots to box, or NULL */
         } compound_proc;
+        struct {
+            node_kind kind;
+            struct object* (*handler)(struct object** node, struct object** env);
+            struct object* first;
+            struct object* second;
+            struct object* third;
+            struct object* code;       /* bytecode compiled by the VM */
+            struct object* expansion;  /* (macro . node) of a macro use */
+        } node;
+        struct {
+            size_t length;
+            struct object* constants;  /* vector */
+            uint32_t* instructions;    /* stored right behind the header */
+        } code;
+        struct {
+            size_t count;
+            struct object* parent;     /* enclosing environment */
+            struct object* variables;  /* vector, names of the slots */
+            struct object* extra;      /* alist of names defined later */
+            struct object** values;    /* stored right behind the header */
+        } frame;
+        struct {
+            struct object* value;
+        } box;
     } data;
 } object;
 
-extern object* alloc_object();
+typedef object* (*node_handler)(object** node, object** env);
+
+extern object* alloc_object(object_type type);
+
+/* the bytes obj takes, its elements, slots or instructions included */
+extern size_t object_bytes(object* obj);
+
+extern object_type type_of   (object* obj);
+
+extern long fixnum_value     (object* obj);
+
+extern char character_value  (object* obj);
 
 extern bool is_empty_list    (object* obj);
 
@@ -99,6 +211,8 @@ extern bool is_primitive_proc(object* obj);
 
 extern bool is_compound_proc (object* obj);
 
+extern bool is_node          (object* obj);
+
 extern bool is_true          (object* obj);
 
 extern bool is_false         (object* obj);
@@ -124,9 +238,31 @@ extern object* make_character(char value);
 
 extern object* make_string(char* str);
 
+extern object* make_sized_string(const char* bytes, size_t length);
+
+extern bool string_equal(object* first, object* second);
+
+/* equal? on data: numbers, strings, symbols, lists and vectors */
+extern bool datum_equal(object* first, object* second);
+
 extern object* make_symbol(char* str);
 
-extern object* make_vector(object* elements, size_t length);
+extern void sweep_symbol_table(void);
+
+/* takes a symbol that is being freed out of the symbol table */
+extern void remove_symbol(object* symbol);
+
+/* called when symbol gets its top level binding */
+extern void add_global_symbol(object* symbol);
+
+/* marks the symbols that have a top level binding, which keep it alive */
+extern void mark_global_symbols(void (*mark)(object* obj));
+
+extern object* make_vector(size_t length, object* fill);
+
+extern object* list_to_vector(object* list, size_t length);
+
+extern object* vector_to_list(object* vector);
 
 extern object* make_port(FILE* file, bool is_input, bool is_output, bool close_on_gc);
 
@@ -134,7 +270,14 @@ extern object* make_macro(object* literals, object* rules, object* env);
 
 extern object* make_continuation(void);
 
-extern void gc_collect(void);
+extern object* make_node(node_kind kind, node_handler handler,
+                         object* first, object* second, object* third);
+
+extern object* make_code(size_t length, object* constants);
+
+extern object* make_frame(size_t count, object* variables, object* parent);
+
+extern object* make_box(object* value);
 
 /**** global object constructor ****/
 extern object* make_symbol_table();
@@ -144,7 +287,6 @@ extern object* get_the_empty_environment();
 extern object *true_obj;
 extern object *false_obj;
 extern object *the_empty_list;
-extern object *symbol_table;
 extern object *quote_symbol;
 extern object *quasiquote_symbol;
 extern object *unquote_symbol;
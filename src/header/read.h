@@ -36,8 +36,6 @@ void destroy_token_list(token_list* list);
 extern
 object* parse(token_list* list);
 
-object* parse_pair(token_list* list);
-
 /***** more *****/
 bool is_str_digit(char* str);
 
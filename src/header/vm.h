@@ -0,0 +1,42 @@
+//
+// bytecode compiler and virtual machine
+//
+
+#ifndef SCHEME_VM_H
+#define SCHEME_VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "object.h"
+
+/*
+ * The VM is the default evaluator: the syntax nodes built by analyze are
+ * compiled to CODE objects and run on an explicit value stack whose
+ * frames are the continuation, so no Scheme call, including the ones made
+ * by apply, map, for-each and call/cc, recurses on the C stack. Compiled
+ * procedure bodies are cached in the code slot of their body node.
+ * Continuations copy the frames they need, so they can be called again
+ * after their call/cc has returned; re-entry is delimited by the vm_eval
+ * or vm_apply that is running when they are called. eval and apply use
+ * the VM while vm_enabled is set; main clears it for the -tree flag,
+ * which falls back to execute.
+ */
+extern bool vm_enabled;
+
+/* looks up the primitives the VM runs itself, after init_built_in */
+extern void vm_init(void);
+
+extern object* vm_eval(object* exp, object* env);
+
+extern object* vm_apply(object* procedure, object* arguments);
+
+/* number of live slots of the VM stack */
+extern size_t vm_stack_top;
+
+/* drops the VM frames above height after an error longjmp */
+extern void vm_unwind(size_t height);
+
+/* calls visit with the address of every object the VM holds on to */
+extern void vm_visit_roots(void (*visit)(object** slot));
+
+#endif //SCHEME_VM_H
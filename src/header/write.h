@@ -9,6 +9,4 @@
 #define SCHEME_WRITE_H
 
 extern void write(FILE* out, object* obj);
-
-void write_pair(FILE*, object*);
 #endif //SCHEME_WRITE_H
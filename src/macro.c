@@ -0,0 +1,471 @@
+//
+// syntax-rules macros
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "header/macro.h"
+#include "header/object.h"
+#include "header/builtin.h"
+#include "header/error.h"
+
+/*
+ * Compiled patterns and templates are vectors whose element 0 is the
+ * kind, followed by:
+ *
+ *   MATCH_ANY                               _
+ *   MATCH_VARIABLE      slot
+ *   MATCH_LITERAL       symbol
+ *   MATCH_DATUM         datum
+ *   MATCH_LIST          before  repeat  after  rest  repeat slots
+ *
+ *   TEMPLATE_CONSTANT   datum
+ *   TEMPLATE_VARIABLE   slot
+ *   TEMPLATE_LIST       items  rest
+ *   TEMPLATE_VECTOR     list template
+ *   TEMPLATE_REPEAT     template  drivers
+ *
+ * A list pattern matches the before matchers, then as many elements as
+ * the after matchers leave to repeat, then the after matchers and rest
+ * against the remaining tail; repeat is #f without an ellipsis. The
+ * repeat slots are the variables bound inside repeat: each ends up
+ * holding the list of what it matched in every repetition, a list of
+ * lists for a variable under two ellipses, and so on.
+ *
+ * A TEMPLATE_REPEAT is an item of a list template followed by one or
+ * more ellipses. Its drivers hold a vector of slots for every ellipsis,
+ * the variables whose lists are walked at that level.
+ */
+typedef enum {MATCH_ANY, MATCH_VARIABLE, MATCH_LITERAL, MATCH_DATUM, MATCH_LIST} match_kind;
+
+typedef enum {TEMPLATE_CONSTANT, TEMPLATE_VARIABLE, TEMPLATE_LIST,
+              TEMPLATE_VECTOR, TEMPLATE_REPEAT} template_kind;
+
+/* a compiled rule is the vector #(matcher template slot-count) */
+#define RULE_MATCHER  0
+#define RULE_TEMPLATE 1
+#define RULE_SLOTS    2
+
+#define KIND(tuple)      ((int) fixnum_value((tuple)->data.vector.elements[0]))
+#define FIELD(tuple, i)  ((tuple)->data.vector.elements[i])
+
+typedef struct {
+    object* literals;
+    object* variables;   /* alist of (name slot . depth) */
+    size_t count;        /* slots used so far */
+    object* underscore;
+} rule_compiler;
+
+static object* make_tuple(int kind, size_t count, ...) {
+    object* tuple = make_vector(count + 1, the_empty_list);
+    va_list fields;
+
+    FIELD(tuple, 0) = make_fixnum(kind);
+    va_start(fields, count);
+    for(size_t i = 1; i <= count; i++)
+        FIELD(tuple, i) = va_arg(fields, object*);
+    va_end(fields);
+    return tuple;
+}
+
+static object* reverse_list(object* list) {
+    object* reversed = the_empty_list;
+    for(; is_pair(list); list = cdr(list))
+        reversed = cons(car(list), reversed);
+    return reversed;
+}
+
+/* a vector of the elements of list, which was built back to front */
+static object* reversed_to_vector(object* list, size_t length) {
+    return list_to_vector(reverse_list(list), length);
+}
+
+static bool list_contains(object* symbol, object* list) {
+    while(is_pair(list)) {
+        if(car(list) == symbol)
+            return true;
+        list = cdr(list);
+    }
+    return false;
+}
+
+/**** compiling ****/
+
+static object* pattern_variable(rule_compiler* c, object* name) {
+    for(object* variables = c->variables; is_pair(variables); variables = cdr(variables))
+        if(car(car(variables)) == name)
+            return cdr(car(variables));
+    return NULL;
+}
+
+#define variable_slot(variable)  (car(variable))
+#define variable_depth(variable) (fixnum_value(cdr(variable)))
+
+static object* compile_pattern(rule_compiler* c, object* pattern, long depth) {
+    if(is_symbol(pattern)) {
+        object* slot;
+
+        if(pattern == c->underscore)
+            return make_tuple(MATCH_ANY, 0);
+        if(list_contains(pattern, c->literals))
+            return make_tuple(MATCH_LITERAL, 1, pattern);
+        if(pattern == ellipsis_symbol)
+            error_handle(stderr, "misplaced ellipsis in pattern", EXIT_FAILURE);
+        if(pattern_variable(c, pattern) != NULL)
+            error_handle(stderr, "duplicate pattern variable", EXIT_FAILURE);
+
+        slot = make_fixnum((long) c->count++);
+        c->variables = cons(cons(pattern, cons(slot, make_fixnum(depth))), c->variables);
+        return make_tuple(MATCH_VARIABLE, 1, slot);
+    }
+
+    if(is_pair(pattern)) {
+        object* before = the_empty_list;
+        object* after = the_empty_list;
+        object* repeat = false_obj;
+        object* repeat_slots = the_empty_list;
+        size_t before_count = 0;
+        size_t after_count = 0;
+        size_t repeat_count = 0;
+
+        for(; is_pair(pattern); pattern = cdr(pattern)) {
+            object* item = car(pattern);
+
+            if(item == ellipsis_symbol)
+                error_handle(stderr, "misplaced ellipsis in pattern", EXIT_FAILURE);
+            if(is_pair(cdr(pattern)) && cadr(pattern) == ellipsis_symbol) {
+                size_t first_slot = c->count;
+
+                if(repeat != false_obj)
+                    error_handle(stderr, "more than one ellipsis in a pattern list", EXIT_FAILURE);
+                repeat = compile_pattern(c, item, depth + 1);
+                for(size_t slot = first_slot; slot < c->count; slot++, repeat_count++)
+                    repeat_slots = cons(make_fixnum((long) slot), repeat_slots);
+                pattern = cdr(pattern);
+            }
+            else if(repeat == false_obj) {
+                before = cons(compile_pattern(c, item, depth), before);
+                before_count++;
+            }
+            else {
+                after = cons(compile_pattern(c, item, depth), after);
+                after_count++;
+            }
+        }
+
+        return make_tuple(MATCH_LIST, 5,
+                          reversed_to_vector(before, before_count),
+                          repeat,
+                          reversed_to_vector(after, after_count),
+                          compile_pattern(c, pattern, depth),
+                          reversed_to_vector(repeat_slots, repeat_count));
+    }
+
+    return make_tuple(MATCH_DATUM, 1, pattern);
+}
+
+static object* compile_template(rule_compiler* c, object* template_exp, long level);
+
+/* slots of the variables in template_exp that are repeated at level */
+static object* template_drivers(rule_compiler* c, object* template_exp,
+                                long level, object* found) {
+    if(is_symbol(template_exp)) {
+        object* variable = pattern_variable(c, template_exp);
+        if(variable != NULL && variable_depth(variable) >= level &&
+           !list_contains(variable_slot(variable), found))
+            found = cons(variable_slot(variable), found);
+    }
+    else if(is_pair(template_exp)) {
+        found = template_drivers(c, car(template_exp), level, found);
+        found = template_drivers(c, cdr(template_exp), level, found);
+    }
+    else if(is_vector(template_exp)) {
+        for(size_t i = 0; i < template_exp->data.vector.length; i++)
+            found = template_drivers(c, template_exp->data.vector.elements[i], level, found);
+    }
+    return found;
+}
+
+static object* compile_repeat(rule_compiler* c, object* item, long level, long ellipses) {
+    object* drivers = the_empty_list;
+
+    for(long i = ellipses; i > 0; i--) {
+        object* slots = template_drivers(c, item, level + i, the_empty_list);
+        size_t count = 0;
+
+        for(object* cursor = slots; is_pair(cursor); cursor = cdr(cursor))
+            count++;
+        if(count == 0)
+            error_handle(stderr, "no pattern variable to repeat in ellipsis template", EXIT_FAILURE);
+        drivers = cons(list_to_vector(slots, count), drivers);
+    }
+    return make_tuple(TEMPLATE_REPEAT, 2,
+                      compile_template(c, item, level + ellipses),
+                      list_to_vector(drivers, (size_t) ellipses));
+}
+
+/* level is the number of ellipses the template is under */
+static object* compile_template(rule_compiler* c, object* template_exp, long level) {
+    if(is_symbol(template_exp)) {
+        object* variable = pattern_variable(c, template_exp);
+
+        if(variable == NULL)
+            return make_tuple(TEMPLATE_CONSTANT, 1, template_exp);
+        if(variable_depth(variable) > level)
+            error_handle(stderr, "pattern variable used with too few ellipses", EXIT_FAILURE);
+        return make_tuple(TEMPLATE_VARIABLE, 1, variable_slot(variable));
+    }
+
+    if(is_pair(template_exp)) {
+        object* items = the_empty_list;
+        object* cursor = template_exp;
+        object* rest;
+        size_t count = 0;
+        bool constant = true;
+
+        for(; is_pair(cursor); cursor = cdr(cursor), count++) {
+            object* item = car(cursor);
+            object* compiled;
+            long ellipses = 0;
+
+            if(item == ellipsis_symbol)
+                error_handle(stderr, "misplaced ellipsis in template", EXIT_FAILURE);
+            while(is_pair(cdr(cursor)) && cadr(cursor) == ellipsis_symbol) {
+                cursor = cdr(cursor);
+                ellipses++;
+            }
+
+            if(ellipses > 0)
+                compiled = compile_repeat(c, item, level, ellipses);
+            else
+                compiled = compile_template(c, item, level);
+            if(KIND(compiled) != TEMPLATE_CONSTANT)
+                constant = false;
+            items = cons(compiled, items);
+        }
+
+        rest = compile_template(c, cursor, level);
+        /* parts without pattern variables are shared by every expansion */
+        if(constant && KIND(rest) == TEMPLATE_CONSTANT)
+            return make_tuple(TEMPLATE_CONSTANT, 1, template_exp);
+        return make_tuple(TEMPLATE_LIST, 2, reversed_to_vector(items, count), rest);
+    }
+
+    if(is_vector(template_exp)) {
+        object* list = compile_template(c, vector_to_list(template_exp), level);
+        if(KIND(list) == TEMPLATE_CONSTANT)
+            return make_tuple(TEMPLATE_CONSTANT, 1, template_exp);
+        return make_tuple(TEMPLATE_VECTOR, 1, list);
+    }
+
+    return make_tuple(TEMPLATE_CONSTANT, 1, template_exp);
+}
+
+/* the keyword position of a pattern is ignored, as in R7RS */
+object* compile_syntax_rules(object* literals, object* rules) {
+    object* compiled = the_empty_list;
+    object* underscore = make_symbol("_");
+
+    for(; is_pair(rules); rules = cdr(rules)) {
+        object* rule = car(rules);
+        rule_compiler c = {literals, the_empty_list, 0, underscore};
+        object* entry = make_vector(3, the_empty_list);
+
+        if(!is_pair(rule) || !is_pair(cdr(rule)) || !is_pair(car(rule)))
+            error_handle(stderr, "invalid syntax-rules rule", EXIT_FAILURE);
+        entry->data.vector.elements[RULE_MATCHER] = compile_pattern(&c, cdr(car(rule)), 0);
+        entry->data.vector.elements[RULE_TEMPLATE] = compile_template(&c, cadr(rule), 0);
+        entry->data.vector.elements[RULE_SLOTS] = make_fixnum((long) c.count);
+        compiled = cons(entry, compiled);
+    }
+    return reverse_list(compiled);
+}
+
+/**** matching ****/
+
+static bool match(object* matcher, object* input, object** slots);
+
+static bool match_items(object* matchers, object** input, object** slots) {
+    for(size_t i = 0; i < matchers->data.vector.length; i++) {
+        if(!is_pair(*input) ||
+           !match(matchers->data.vector.elements[i], car(*input), slots))
+            return false;
+        *input = cdr(*input);
+    }
+    return true;
+}
+
+static bool match_list(object* matcher, object* input, object** slots) {
+    object* repeat = FIELD(matcher, 2);
+    object* after = FIELD(matcher, 3);
+
+    if(!match_items(FIELD(matcher, 1), &input, slots))
+        return false;
+
+    if(repeat != false_obj) {
+        object* repeat_slots = FIELD(matcher, 5);
+        size_t count = repeat_slots->data.vector.length;
+        object* collected = make_vector(count, the_empty_list);
+        size_t available = 0;
+
+        for(object* cursor = input; is_pair(cursor); cursor = cdr(cursor))
+            available++;
+        if(available < after->data.vector.length)
+            return false;
+
+        for(size_t n = available - after->data.vector.length; n > 0; n--) {
+            if(!match(repeat, car(input), slots))
+                return false;
+            for(size_t i = 0; i < count; i++) {
+                long slot = fixnum_value(repeat_slots->data.vector.elements[i]);
+                collected->data.vector.elements[i] =
+                    cons(slots[slot], collected->data.vector.elements[i]);
+            }
+            input = cdr(input);
+        }
+        for(size_t i = 0; i < count; i++) {
+            long slot = fixnum_value(repeat_slots->data.vector.elements[i]);
+            slots[slot] = reverse_list(collected->data.vector.elements[i]);
+        }
+    }
+
+    if(!match_items(after, &input, slots))
+        return false;
+    return match(FIELD(matcher, 4), input, slots);
+}
+
+static bool match(object* matcher, object* input, object** slots) {
+    switch((match_kind) KIND(matcher)) {
+        case MATCH_ANY:
+            return true;
+        case MATCH_VARIABLE:
+            slots[fixnum_value(FIELD(matcher, 1))] = input;
+            return true;
+        case MATCH_LITERAL:
+            return input == FIELD(matcher, 1);
+        case MATCH_DATUM:
+            return datum_equal(FIELD(matcher, 1), input);
+        case MATCH_LIST:
+            return match_list(matcher, input, slots);
+    }
+    return false;
+}
+
+/**** expanding ****/
+
+static object* expand_template(object* builder, object** slots);
+
+static void append_cell(object** head, object** tail, object* value) {
+    object* cell = cons(value, the_empty_list);
+    if(is_empty_list(*head))
+        *head = cell;
+    else
+        set_cdr(*tail, cell);
+    *tail = cell;
+}
+
+/* walks the lists of the drivers of level in step, putting one element
+ * of each in its slot at a time, and puts them back afterwards */
+static void expand_repeat(object* repeat, size_t level, object** slots,
+                          object** head, object** tail) {
+    object* levels = FIELD(repeat, 2);
+    object* drivers = levels->data.vector.elements[level];
+    size_t count = drivers->data.vector.length;
+    /* the whole lists, then the part of each that is left */
+    object* lists = make_vector(count * 2, the_empty_list);
+    object** cursors = lists->data.vector.elements + count;
+
+    for(size_t i = 0; i < count; i++) {
+        lists->data.vector.elements[i] = slots[fixnum_value(drivers->data.vector.elements[i])];
+        cursors[i] = lists->data.vector.elements[i];
+    }
+
+    for(;;) {
+        size_t ended = 0;
+
+        for(size_t i = 0; i < count; i++) {
+            if(!is_pair(cursors[i])) {
+                ended++;
+                continue;
+            }
+            slots[fixnum_value(drivers->data.vector.elements[i])] = car(cursors[i]);
+            cursors[i] = cdr(cursors[i]);
+        }
+        if(ended == count)
+            break;
+        if(ended > 0)
+            error_handle(stderr, "pattern variables repeated a different number of times", EXIT_FAILURE);
+
+        if(level + 1 < levels->data.vector.length)
+            expand_repeat(repeat, level + 1, slots, head, tail);
+        else
+            append_cell(head, tail, expand_template(FIELD(repeat, 1), slots));
+    }
+
+    for(size_t i = 0; i < count; i++)
+        slots[fixnum_value(drivers->data.vector.elements[i])] = lists->data.vector.elements[i];
+}
+
+static object* expand_template(object* builder, object** slots) {
+    switch((template_kind) KIND(builder)) {
+        case TEMPLATE_CONSTANT:
+            return FIELD(builder, 1);
+        case TEMPLATE_VARIABLE:
+            return slots[fixnum_value(FIELD(builder, 1))];
+        case TEMPLATE_LIST: {
+            object* items = FIELD(builder, 1);
+            object* head = the_empty_list;
+            object* tail = the_empty_list;
+            object* rest;
+
+            for(size_t i = 0; i < items->data.vector.length; i++) {
+                object* item = items->data.vector.elements[i];
+                if(KIND(item) == TEMPLATE_REPEAT)
+                    expand_repeat(item, 0, slots, &head, &tail);
+                else
+                    append_cell(&head, &tail, expand_template(item, slots));
+            }
+            rest = expand_template(FIELD(builder, 2), slots);
+            if(is_empty_list(head))
+                return rest;
+            set_cdr(tail, rest);
+            return head;
+        }
+        case TEMPLATE_VECTOR: {
+            object* expanded = expand_template(FIELD(builder, 1), slots);
+            size_t length = 0;
+            object* cursor = expanded;
+            while(is_pair(cursor)) {
+                length++;
+                cursor = cdr(cursor);
+            }
+            if(!is_empty_list(cursor))
+                error_handle(stderr, "vector template expansion must be proper list", EXIT_FAILURE);
+            return list_to_vector(expanded, length);
+        }
+        case TEMPLATE_REPEAT:
+            break;
+    }
+    error_handle(stderr, "misplaced ellipsis in template", EXIT_FAILURE);
+    return NULL;
+}
+
+object* try_expand_macro_application(object* macro, object* form) {
+    for(object* rules = macro->data.macro.rules; is_pair(rules); rules = cdr(rules)) {
+        object** rule = car(rules)->data.vector.elements;
+        object* slots = make_vector((size_t) fixnum_value(rule[RULE_SLOTS]), the_empty_list);
+
+        if(match(rule[RULE_MATCHER], cdr(form), slots->data.vector.elements))
+            return expand_template(rule[RULE_TEMPLATE], slots->data.vector.elements);
+    }
+    return NULL;
+}
+
+object* expand_macro_application(object* macro, object* form) {
+    object* expansion = try_expand_macro_application(macro, form);
+
+    if(expansion == NULL)
+        error_handle(stderr, "macro pattern did not match", EXIT_FAILURE);
+    return expansion;
+}
@@ -4,11 +4,35 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include "header/object.h"
+#include "header/gc.h"
 #include "header/error.h"
 
-static object* gc_allocated_objects = NULL;
+#define OBJECT_SIZE(variant) \
+    (offsetof(object, data) + sizeof(((object*) 0)->data.variant))
+
+/*
+ * Interned symbols are kept in an open addressing hash table keyed on
+ * the symbol name. The table holds its symbols weakly: it is not a GC
+ * root, and a symbol leaves it when the sweep frees it, or all the
+ * unmarked ones at once with sweep_symbol_table. Until then a dead
+ * symbol that is looked up again is revived. The symbols that have a
+ * top level binding are listed apart, they are roots.
+ */
+#define SYMBOL_TABLE_MIN_CAPACITY 256
+#define SYMBOL_TOMBSTONE (&symbol_tombstone)
+
+static object symbol_tombstone;
+static object** symbol_table = NULL;
+static size_t symbol_table_capacity = 0;
+static size_t symbol_table_used = 0;     /* live entries and tombstones */
+static size_t symbol_table_live = 0;
+
+static object** global_symbols = NULL;
+static size_t global_symbol_count = 0;
+static size_t global_symbol_capacity = 0;
 
 static char* copy_string(const char* str) {
     size_t len;
@@ -26,96 +50,31 @@ static char* copy_string(const char* str) {
     return dst;
 }
 
-static void gc_mark(object* obj) {
-    if(obj == NULL || obj->gc_marked)
-        return;
-
-    obj->gc_marked = true;
-    switch(obj->type) {
-        case PAIR:
-            gc_mark(obj->data.pair.car);
-            gc_mark(obj->data.pair.cdr);
-            break;
-        case VECTOR:
-            gc_mark(obj->data.vector.elements);
-            break;
-        case MACRO:
-            gc_mark(obj->data.macro.literals);
-            gc_mark(obj->data.macro.rules);
-            gc_mark(obj->data.macro.env);
-            break;
-        case CONTINUATION:
-            gc_mark(obj->data.continuation.value);
-            break;
-        case COMPOUND_PROC:
-            gc_mark(obj->data.compound_proc.parameters);
-            gc_mark(obj->data.compound_proc.body);
-            gc_mark(obj->data.compound_proc.env);
-            break;
+static size_t object_size(object_type type) {
+    switch(type) {
+        case SYMBOL:         return OBJECT_SIZE(symbol);
+        case FIXNUM:         return OBJECT_SIZE(fixnum);
+        case STRING:         return OBJECT_SIZE(string);
+        case PAIR:           return OBJECT_SIZE(pair);
+        case VECTOR:         return OBJECT_SIZE(vector);
+        case PORT:           return OBJECT_SIZE(port);
+        case MACRO:          return OBJECT_SIZE(macro);
+        case CONTINUATION:   return OBJECT_SIZE(continuation);
+        case PRIMITIVE_PROC: return OBJECT_SIZE(primitive_proc);
+        case COMPOUND_PROC:  return OBJECT_SIZE(compound_proc);
+        case NODE:           return OBJECT_SIZE(node);
+        case CODE:           return OBJECT_SIZE(code);
+        case FRAME:          return OBJECT_SIZE(frame);
+        case BOX:            return OBJECT_SIZE(box);
         default:
-            break;
+            error_handle(stderr, "cannot allocate an immediate type", EXIT_FAILURE);
     }
+    return 0;
 }
 
-static void gc_mark_roots(void) {
-    gc_mark(true_obj);
-    gc_mark(false_obj);
-    gc_mark(the_empty_list);
-    gc_mark(symbol_table);
-    gc_mark(quote_symbol);
-    gc_mark(quasiquote_symbol);
-    gc_mark(unquote_symbol);
-    gc_mark(unquote_splicing_symbol);
-    gc_mark(define_symbol);
-    gc_mark(define_syntax_symbol);
-    gc_mark(syntax_rules_symbol);
-    gc_mark(ellipsis_symbol);
-    gc_mark(set_symbol);
-    gc_mark(ok_symbol);
-    gc_mark(if_symbol);
-    gc_mark(lambda_symbol);
-    gc_mark(begin_symbol);
-    gc_mark(cond_symbol);
-    gc_mark(else_symbol);
-    gc_mark(let_symbol);
-    gc_mark(let_star_symbol);
-    gc_mark(letrec_symbol);
-    gc_mark(and_symbol);
-    gc_mark(or_symbol);
-    gc_mark(unassigned_symbol);
-    gc_mark(eof_object);
-    gc_mark(the_empty_environment);
-    gc_mark(the_global_environment);
-}
-
-static void gc_sweep(void) {
-    object** current = &gc_allocated_objects;
-
-    while(*current != NULL) {
-        object* obj = *current;
-        if(!obj->gc_marked) {
-            *current = obj->gc_next;
-            if(obj->type == SYMBOL && obj->data.symbol.value != NULL)
-                free(obj->data.symbol.value);
-            if(obj->type == STRING && obj->data.string.value != NULL)
-                free(obj->data.string.value);
-            if(obj->type == PORT &&
-               obj->data.port.file != NULL &&
-               obj->data.port.close_on_gc)
-                fclose(obj->data.port.file);
-            free(obj);
-        }
-        else {
-            obj->gc_marked = false;
-            current = &obj->gc_next;
-        }
-    }
-}
-
-object *true_obj = NULL;
-object *false_obj = NULL;
-object *the_empty_list = NULL;
-object *symbol_table = NULL;
+object *true_obj = TRUE_VALUE;
+object *false_obj = FALSE_VALUE;
+object *the_empty_list = EMPTY_LIST_VALUE;
 object *quote_symbol = NULL;
 object *quasiquote_symbol = NULL;
 object *unquote_symbol = NULL;
@@ -141,73 +100,106 @@ object *eof_object = NULL;
 object *the_empty_environment = NULL;
 object *the_global_environment = NULL;
 
-object* alloc_object() {
-    object* obj = (object*) malloc (sizeof(object));
+object* alloc_object(object_type type) {
+    object* obj;
 
-    if(obj == NULL){
-        error_handle(stderr, "out of memory", EXIT_FAILURE);
-    }
-    obj->gc_marked = false;
-    obj->gc_next = gc_allocated_objects;
-    gc_allocated_objects = obj;
+    /* symbols never move, the symbol table refers to them weakly */
+    if(type == SYMBOL)
+        obj = gc_allocate_tenured(object_size(type));
+    else
+        obj = gc_allocate(object_size(type));
+    obj->type = type;
+    if(type == STRING || type == PORT || type == CONTINUATION)
+        gc_track_finalizer(obj);
     return obj;
 }
 
-void gc_collect(void) {
-    gc_mark_roots();
-    gc_sweep();
+size_t object_bytes(object* obj) {
+    switch(obj->type) {
+        case VECTOR:
+            return OBJECT_SIZE(vector) + obj->data.vector.length * sizeof(object*);
+        case CODE:
+            return OBJECT_SIZE(code) + obj->data.code.length * sizeof(uint32_t);
+        case FRAME:
+            return OBJECT_SIZE(frame) + obj->data.frame.count * sizeof(object*);
+        default:
+            return object_size(obj->type);
+    }
+}
+
+object_type type_of(object* obj) {
+    if(is_fixnum_immediate(obj))
+        return FIXNUM;
+    if(is_immediate(obj))
+        return immediate_type(obj);
+    return obj->type;
+}
+
+long fixnum_value(object* obj) {
+    if(is_fixnum_immediate(obj))
+        return (long)((intptr_t)obj >> 1);
+    return obj->data.fixnum.value;
+}
+
+char character_value(object* obj) {
+    return (char)(unsigned char)immediate_value(obj);
 }
 
 bool is_empty_list(object* obj) {
-    return obj->type == THE_EMPTY_LIST ? true : false;
+    return obj == the_empty_list ? true : false;
 }
 
 bool is_boolean(object* obj) {
-    return obj->type == BOOLEAN ? true : false;
+    return obj == true_obj || obj == false_obj ? true : false;
 }
 
 bool is_symbol(object* obj) {
-    return obj->type == SYMBOL ? true : false;
+    return type_of(obj) == SYMBOL ? true : false;
 }
 
 bool is_fixnum(object* obj) {
-    return obj->type == FIXNUM ? true : false;
+    return type_of(obj) == FIXNUM ? true : false;
 }
 
 bool is_character(object* obj) {
-    return obj->type == CHARACTER ? true : false;
+    return is_immediate(obj) && !is_fixnum_immediate(obj) &&
+           immediate_type(obj) == CHARACTER ? true : false;
 }
 
 bool is_string(object* obj) {
-    return obj->type == STRING ? true : false;
+    return type_of(obj) == STRING ? true : false;
 }
 
 bool is_pair(object* obj) {
-    return obj->type == PAIR ? true : false;
+    return !is_immediate(obj) && obj->type == PAIR ? true : false;
 }
 
 bool is_vector(object* obj) {
-    return obj->type == VECTOR ? true : false;
+    return type_of(obj) == VECTOR ? true : false;
 }
 
 bool is_port(object* obj) {
-    return obj->type == PORT ? true : false;
+    return type_of(obj) == PORT ? true : false;
 }
 
 bool is_macro(object* obj) {
-    return obj->type == MACRO ? true : false;
+    return type_of(obj) == MACRO ? true : false;
 }
 
 bool is_continuation(object* obj) {
-    return obj->type == CONTINUATION ? true : false;
+    return type_of(obj) == CONTINUATION ? true : false;
 }
 
 bool is_primitive_proc(object* obj) {
-    return obj->type == PRIMITIVE_PROC ? true : false;
+    return type_of(obj) == PRIMITIVE_PROC ? true : false;
 }
 
 bool is_compound_proc(object* obj) {
-    return obj->type == COMPOUND_PROC ? true : false;
+    return type_of(obj) == COMPOUND_PROC ? true : false;
+}
+
+bool is_node(object* obj) {
+    return type_of(obj) == NODE ? true : false;
 }
 
 bool is_true(object* obj) {
@@ -215,9 +207,7 @@ bool is_true(object* obj) {
 }
 
 bool is_false(object* obj) {
-    return obj != NULL &&
-           obj->type == BOOLEAN &&
-           obj->data.boolean.value == false ? true : false;
+    return obj == false_obj ? true : false;
 }
 
 object* car(object* pair) {
@@ -229,8 +219,7 @@ object* cdr(object* pair) {
 }
 
 object* cons(object* car, object* cdr) {
-    object* pair = alloc_object();
-    pair->type = PAIR;
+    object* pair = alloc_object(PAIR);
     pair->data.pair.car = car;
     pair->data.pair.cdr = cdr;
 
@@ -239,10 +228,12 @@ object* cons(object* car, object* cdr) {
 
 void set_car(object* pair, object* car) {
     pair->data.pair.car = car;
+    gc_write_barrier(pair, car);
 }
 
 void set_cdr(object* pair, object* cdr) {
     pair->data.pair.cdr = cdr;
+    gc_write_barrier(pair, cdr);
 }
 
 //object* make_the_empty_list() {
@@ -252,70 +243,269 @@ void set_cdr(object* pair, object* cdr) {
 //}
 
 object* make_boolean(bool value) {
-    object* obj = alloc_object();
-    obj->type = BOOLEAN;
-    if(value == true)
-        obj->data.boolean.value = true;
-    else
-        obj->data.boolean.value = false;
-
-    return obj;
+    return value ? true_obj : false_obj;
 }
 
 object* make_fixnum(long value) {
-     object* obj = alloc_object();
-     obj->type = FIXNUM;
-     obj->data.fixnum.value = value;
+    object* obj;
+
+    if(value >= FIXNUM_MIN && value <= FIXNUM_MAX)
+        return (object*)(((uintptr_t)value << 1) | FIXNUM_TAG);
 
-     return obj;
+    obj = alloc_object(FIXNUM);
+    obj->data.fixnum.value = value;
+    return obj;
 }
 
 object* make_character(char value) {
-    object* obj = alloc_object();
-    obj->type = CHARACTER;
-    obj->data.character.value = value;
-    return obj;
+    return make_immediate(CHARACTER, (unsigned char)value);
 }
 
 object* make_string(char* str) {
+    return make_sized_string(str, strlen(str));
+}
+
+/* copies length bytes, NULs included; bytes may be NULL for a blank string */
+object* make_sized_string(const char* bytes, size_t length) {
+    object* obj = alloc_object(STRING);
+    char* value = (char*) malloc(length + 1);
 
-    object* obj = alloc_object();
-    obj->type = STRING;
-    obj->data.string.value = copy_string(str);
+    if(value == NULL)
+        error_handle(stderr, "out of memory", EXIT_FAILURE);
+    if(bytes != NULL && length > 0)
+        memcpy(value, bytes, length);
+    value[length] = '\0';
+    gc_account(length + 1);
+
+    obj->data.string.value = value;
+    obj->data.string.length = length;
+    obj->data.string.capacity = length;
     return obj;
 }
 
+bool string_equal(object* first, object* second) {
+    return first->data.string.length == second->data.string.length &&
+           memcmp(first->data.string.value, second->data.string.value,
+                  first->data.string.length) == 0;
+}
+
+/*
+ * equal? on data. The pairs still to be compared wait on a stack of
+ * their own instead of the C stack, so a long list costs one entry and
+ * only deep nesting makes the stack grow.
+ */
+bool datum_equal(object* first, object* second) {
+    object** pending = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool equal = true;
+
+    for(;;) {
+        if(first != second) {
+            if(type_of(first) != type_of(second)) {
+                equal = false;
+                break;
+            }
+            switch(type_of(first)) {
+                case FIXNUM:
+                    equal = fixnum_value(first) == fixnum_value(second);
+                    break;
+                case STRING:
+                    equal = string_equal(first, second);
+                    break;
+                case PAIR:
+                case VECTOR: {
+                    size_t length = is_pair(first) ? 1 : first->data.vector.length;
+
+                    if(is_vector(first) && length != second->data.vector.length) {
+                        equal = false;
+                        break;
+                    }
+                    if(count + 2 * length > capacity) {
+                        size_t new_capacity = capacity == 0 ? 64 : capacity;
+                        while(new_capacity < count + 2 * length)
+                            new_capacity *= 2;
+                        object** grown = realloc(pending, new_capacity * sizeof(object*));
+                        if(grown == NULL)
+                            error_handle(stderr, "out of memory", EXIT_FAILURE);
+                        pending = grown;
+                        capacity = new_capacity;
+                    }
+                    if(is_pair(first)) {
+                        pending[count++] = cdr(first);
+                        pending[count++] = cdr(second);
+                        first = car(first);
+                        second = car(second);
+                        continue;
+                    }
+                    for(size_t i = length; i > 0; i--) {
+                        pending[count++] = first->data.vector.elements[i - 1];
+                        pending[count++] = second->data.vector.elements[i - 1];
+                    }
+                    break;
+                }
+                default:
+                    equal = false;
+                    break;
+            }
+            if(!equal)
+                break;
+        }
+        if(count == 0)
+            break;
+        second = pending[--count];
+        first = pending[--count];
+    }
+    free(pending);
+    return equal;
+}
+
+static unsigned long hash_string(const char* str) {
+    unsigned long hash = 2166136261UL;   /* FNV-1a */
+
+    while(*str != '\0') {
+        hash ^= (unsigned char) *str++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+static void symbol_table_insert(object* symbol) {
+    size_t mask = symbol_table_capacity - 1;
+    size_t i = symbol->data.symbol.hash & mask;
+
+    while(symbol_table[i] != NULL && symbol_table[i] != SYMBOL_TOMBSTONE)
+        i = (i + 1) & mask;
+    if(symbol_table[i] == NULL)
+        symbol_table_used++;
+    symbol_table[i] = symbol;
+    symbol_table_live++;
+}
+
+static void symbol_table_resize(void) {
+    object** old_table = symbol_table;
+    size_t old_capacity = symbol_table_capacity;
+    size_t capacity = SYMBOL_TABLE_MIN_CAPACITY;
+
+    while(capacity < symbol_table_live * 4)
+        capacity *= 2;
+
+    symbol_table = (object**) calloc(capacity, sizeof(object*));
+    if(symbol_table == NULL)
+        error_handle(stderr, "out of memory", EXIT_FAILURE);
+    symbol_table_capacity = capacity;
+    symbol_table_used = 0;
+    symbol_table_live = 0;
+
+    /* rehash with the cached hashes, dropping tombstones on the way */
+    for(size_t i = 0; i < old_capacity; i++)
+        if(old_table[i] != NULL && old_table[i] != SYMBOL_TOMBSTONE)
+            symbol_table_insert(old_table[i]);
+    free(old_table);
+}
+
 object* make_symbol(char* str) {
-    /* init symbol table if it is not exist */
-//    if(symbol_table == NULL)
-//        symbol_table = make_symbol_table();
+    unsigned long hash = hash_string(str);
+    size_t mask;
+    size_t i;
+    object* obj;
+
+    if((symbol_table_used + 1) * 2 > symbol_table_capacity)
+        symbol_table_resize();
 
     /* if symbol table contain the symbol */
-    for(object* obj = symbol_table;
-        !is_empty_list(obj); obj = cdr(obj))
-        if(strcmp(car(obj)->data.symbol.value, str) == 0)
-            return car(obj);
+    mask = symbol_table_capacity - 1;
+    for(i = hash & mask; symbol_table[i] != NULL; i = (i + 1) & mask) {
+        obj = symbol_table[i];
+        if(obj != SYMBOL_TOMBSTONE &&
+           obj->data.symbol.hash == hash &&
+           strcmp(obj->data.symbol.value, str) == 0) {
+            gc_revive(obj);
+            return obj;
+        }
+    }
 
     /* create symbol and add into symbol table */
-    object* obj = alloc_object();
-    obj->type = SYMBOL;
+    obj = alloc_object(SYMBOL);
     obj->data.symbol.value = copy_string(str);
+    obj->data.symbol.hash = hash;
+    obj->data.symbol.global_value = NULL;
 
-    symbol_table = cons(obj, symbol_table);
+    symbol_table_insert(obj);
     return obj;
 }
 
-object* make_vector(object* elements, size_t length) {
-    object* obj = alloc_object();
+void remove_symbol(object* symbol) {
+    size_t mask = symbol_table_capacity - 1;
+
+    for(size_t i = symbol->data.symbol.hash & mask; symbol_table[i] != NULL; i = (i + 1) & mask) {
+        if(symbol_table[i] == symbol) {
+            symbol_table[i] = SYMBOL_TOMBSTONE;
+            symbol_table_live--;
+            return;
+        }
+    }
+}
+
+void add_global_symbol(object* symbol) {
+    if(global_symbol_count == global_symbol_capacity) {
+        size_t new_capacity = global_symbol_capacity == 0 ? 256 : global_symbol_capacity * 2;
+        object** grown = realloc(global_symbols, new_capacity * sizeof(object*));
+        if(grown == NULL)
+            error_handle(stderr, "out of memory", EXIT_FAILURE);
+        global_symbols = grown;
+        global_symbol_capacity = new_capacity;
+    }
+    global_symbols[global_symbol_count++] = symbol;
+}
+
+void mark_global_symbols(void (*mark)(object* obj)) {
+    for(size_t i = 0; i < global_symbol_count; i++)
+        mark(global_symbols[i]);
+}
+
+void sweep_symbol_table(void) {
+    for(size_t i = 0; i < symbol_table_capacity; i++) {
+        object* obj = symbol_table[i];
+        if(obj != NULL && obj != SYMBOL_TOMBSTONE && !gc_is_marked(obj)) {
+            symbol_table[i] = SYMBOL_TOMBSTONE;
+            symbol_table_live--;
+        }
+    }
+}
+
+object* make_vector(size_t length, object* fill) {
+    size_t header = OBJECT_SIZE(vector);
+    object* obj = gc_allocate(header + length * sizeof(object*));
+
     obj->type = VECTOR;
-    obj->data.vector.elements = elements;
     obj->data.vector.length = length;
+    obj->data.vector.elements = (object**)((char*) obj + header);
+    for(size_t i = 0; i < length; i++)
+        obj->data.vector.elements[i] = fill;
     return obj;
 }
 
+object* list_to_vector(object* list, size_t length) {
+    object* obj = make_vector(length, the_empty_list);
+
+    for(size_t i = 0; i < length; i++) {
+        obj->data.vector.elements[i] = car(list);
+        list = cdr(list);
+    }
+    return obj;
+}
+
+object* vector_to_list(object* vector) {
+    object* list = the_empty_list;
+
+    for(size_t i = vector->data.vector.length; i > 0; i--)
+        list = cons(vector->data.vector.elements[i - 1], list);
+    return list;
+}
+
 object* make_port(FILE* file, bool is_input, bool is_output, bool close_on_gc) {
-    object* obj = alloc_object();
-    obj->type = PORT;
+    object* obj = alloc_object(PORT);
     obj->data.port.file = file;
     obj->data.port.is_input = is_input;
     obj->data.port.is_output = is_output;
@@ -324,8 +514,7 @@ object* make_port(FILE* file, bool is_input, bool is_output, bool close_on_gc) {
 }
 
 object* make_macro(object* literals, object* rules, object* env) {
-    object* obj = alloc_object();
-    obj->type = MACRO;
+    object* obj = alloc_object(MACRO);
     obj->data.macro.literals = literals;
     obj->data.macro.rules = rules;
     obj->data.macro.env = env;
@@ -333,10 +522,64 @@ object* make_macro(object* literals, object* rules, object* env) {
 }
 
 object* make_continuation(void) {
-    object* obj = alloc_object();
-    obj->type = CONTINUATION;
-    obj->data.continuation.active = false;
+    object* obj = alloc_object(CONTINUATION);
+    obj->data.continuation.point = (continuation_point*) malloc(sizeof(continuation_point));
+    if(obj->data.continuation.point == NULL)
+        error_handle(stderr, "out of memory", EXIT_FAILURE);
+    obj->data.continuation.point->active = false;
+    obj->data.continuation.point->run = NULL;
+    obj->data.continuation.point->frame = 0;
+    obj->data.continuation.point->height = 0;
     obj->data.continuation.value = NULL;
+    obj->data.continuation.parent = NULL;
+    obj->data.continuation.frames = NULL;
+    return obj;
+}
+
+object* make_node(node_kind kind, node_handler handler,
+                  object* first, object* second, object* third) {
+    object* obj = alloc_object(NODE);
+    obj->data.node.kind = kind;
+    obj->data.node.handler = handler;
+    obj->data.node.first = first;
+    obj->data.node.second = second;
+    obj->data.node.third = third;
+    obj->data.node.code = NULL;
+    obj->data.node.expansion = NULL;
+    return obj;
+}
+
+object* make_code(size_t length, object* constants) {
+    size_t header = OBJECT_SIZE(code);
+    object* obj = gc_allocate(header + length * sizeof(uint32_t));
+
+    obj->type = CODE;
+    obj->data.code.length = length;
+    obj->data.code.constants = constants;
+    obj->data.code.instructions = (uint32_t*)((char*) obj + header);
+    return obj;
+}
+
+/* slots start out NULL, the value of a definition that has not run */
+object* make_frame(size_t count, object* variables, object* parent) {
+    size_t header = OBJECT_SIZE(frame);
+    object* obj = gc_allocate(header + count * sizeof(object*));
+
+    obj->type = FRAME;
+    obj->data.frame.count = count;
+    obj->data.frame.parent = parent;
+    obj->data.frame.variables = variables;
+    obj->data.frame.extra = the_empty_list;
+    obj->data.frame.values = (object**)((char*) obj + header);
+    for(size_t i = 0; i < count; i++)
+        obj->data.frame.values[i] = NULL;
+    return obj;
+}
+
+object* make_box(object* value) {
+    object* obj = alloc_object(BOX);
+
+    obj->data.box.value = value;
     return obj;
 }
 
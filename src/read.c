@@ -20,7 +20,6 @@ extern int isatty(int fd);
 
 #define MAXSIZE 10240
 
-static object* parse_vector_elements(token_list* list, size_t* length);
 static object* parse_character(const char* token_value);
 static bool is_str_character(const char* str);
 
@@ -425,63 +424,10 @@ void destroy_token_list(token_list* list) {
     free(list);
 }
 
-object* parse(token_list* list) {
-    if(list == NULL || list->token_pointer == NULL)
-        error_handle(stderr, "unexpected EOF while reading", EXIT_FAILURE);
-
+/* a datum that is not a list, vector or quotation */
+static object* parse_atom(token_list* list) {
     char* token_value = list->token_pointer->value;
 
-    if(strcmp(token_value, "(") == 0) {
-        list_iter(list);
-        return parse_pair(list);
-    }
-
-    if(strcmp(token_value, "#(") == 0) {
-        size_t length = 0;
-        list_iter(list);
-        return make_vector(parse_vector_elements(list, &length), length);
-    }
-
-    if(strcmp(token_value, "'") == 0) {
-        object* quoted_exp;
-        list_iter(list);
-        if(list->token_pointer == NULL)
-            error_handle(stderr, "quote missing expression\n", EXIT_FAILURE);
-
-        quoted_exp = parse(list);
-        return cons(quote_symbol, cons(quoted_exp, the_empty_list));
-    }
-
-    if(strcmp(token_value, "`") == 0) {
-        object* quoted_exp;
-        list_iter(list);
-        if(list->token_pointer == NULL)
-            error_handle(stderr, "quasiquote missing expression\n", EXIT_FAILURE);
-
-        quoted_exp = parse(list);
-        return cons(quasiquote_symbol, cons(quoted_exp, the_empty_list));
-    }
-
-    if(strcmp(token_value, ",") == 0) {
-        object* quoted_exp;
-        list_iter(list);
-        if(list->token_pointer == NULL)
-            error_handle(stderr, "unquote missing expression\n", EXIT_FAILURE);
-
-        quoted_exp = parse(list);
-        return cons(unquote_symbol, cons(quoted_exp, the_empty_list));
-    }
-
-    if(strcmp(token_value, ",@") == 0) {
-        object* quoted_exp;
-        list_iter(list);
-        if(list->token_pointer == NULL)
-            error_handle(stderr, "unquote-splicing missing expression\n", EXIT_FAILURE);
-
-        quoted_exp = parse(list);
-        return cons(unquote_splicing_symbol, cons(quoted_exp, the_empty_list));
-    }
-
     if(strcmp(token_value, "...") == 0) {
         list_iter(list);
         return ellipsis_symbol;
@@ -509,12 +455,12 @@ object* parse(token_list* list) {
 
     if(strcmp(token_value, "#t") == 0) {
         list_iter(list);
-        return make_boolean(true);
+        return true_obj;
     }
 
     if(strcmp(token_value, "#f") == 0) {
         list_iter(list);
-        return make_boolean(false);
+        return false_obj;
     }
 
     char error_msg[TOKEN_MAX + 50];
@@ -523,31 +469,183 @@ object* parse(token_list* list) {
     return NULL;
 }
 
-object* parse_pair(token_list* list) {
-    if(list->token_pointer == NULL)
-        error_handle(stderr, "unexpected EOF while reading list", EXIT_FAILURE);
+/*
+ * A list, vector or quotation the reader is inside of. For a list the
+ * elements read so far; dot is 1 after the '.' of an improper list and
+ * 2 once the datum after it, kept in rest, has been read.
+ */
+typedef enum {READ_LIST, READ_VECTOR, READ_QUOTE} read_kind;
+
+typedef struct {
+    read_kind kind;
+    object* head;
+    object* tail;
+    object* rest;
+    size_t length;
+    int dot;
+    object* quote;   /* the symbol wrapping the datum of a quotation */
+} read_frame;
+
+static read_frame* read_stack = NULL;
+static size_t read_stack_capacity = 0;
+
+static read_frame* push_read_frame(size_t* count, read_kind kind) {
+    read_frame* frame;
+
+    if(*count == read_stack_capacity) {
+        size_t capacity = read_stack_capacity == 0 ? 16 : read_stack_capacity * 2;
+        read_frame* frames = (read_frame*) realloc(read_stack, capacity * sizeof(read_frame));
+
+        if(frames == NULL)
+            error_handle(stderr, "out of memory", EXIT_FAILURE);
+        read_stack = frames;
+        read_stack_capacity = capacity;
+    }
+    frame = &read_stack[(*count)++];
+    frame->kind = kind;
+    frame->head = the_empty_list;
+    frame->tail = the_empty_list;
+    frame->rest = the_empty_list;
+    frame->length = 0;
+    frame->dot = 0;
+    frame->quote = NULL;
+    return frame;
+}
 
-    if(strcmp(list->token_pointer->value, ")") == 0) {
-        list_iter(list);
-        return the_empty_list;
+static const struct {
+    const char* token;
+    char* missing;
+} quotations[] = {
+    {"'",  "quote missing expression\n"},
+    {"`",  "quasiquote missing expression\n"},
+    {",",  "unquote missing expression\n"},
+    {",@", "unquote-splicing missing expression\n"},
+};
+
+static object* quotation_symbol(size_t index) {
+    switch(index) {
+        case 0:  return quote_symbol;
+        case 1:  return quasiquote_symbol;
+        case 2:  return unquote_symbol;
+        default: return unquote_splicing_symbol;
     }
+}
 
-    if(strcmp(list->token_pointer->value, ".") == 0) {
-        object* tail;
-        list_iter(list);
-        if(list->token_pointer == NULL)
-            error_handle(stderr, "dotted pair missing cdr", EXIT_FAILURE);
-        tail = parse(list);
-        if(list->token_pointer == NULL || strcmp(list->token_pointer->value, ")") != 0)
-            error_handle(stderr, "dotted pair missing closing ')'", EXIT_FAILURE);
-        list_iter(list);
-        return tail;
+static bool is_quotation(const char* token_value, size_t* index) {
+    for(size_t i = 0; i < sizeof(quotations) / sizeof(quotations[0]); i++) {
+        if(strcmp(token_value, quotations[i].token) == 0) {
+            *index = i;
+            return true;
+        }
     }
+    return false;
+}
+
+/*
+ * Reads one datum. The lists, vectors and quotations it is inside of
+ * are kept on a stack of their own, so nesting and length are limited
+ * by memory only and not by the C stack.
+ */
+object* parse(token_list* list) {
+    size_t count = 0;
+
+    if(list == NULL)
+        error_handle(stderr, "unexpected EOF while reading", EXIT_FAILURE);
+
+    for(;;) {
+        read_frame* top = count > 0 ? &read_stack[count - 1] : NULL;
+        object* datum = NULL;
+        char* token_value;
+        size_t quotation;
+
+        if(top != NULL && top->kind == READ_LIST && top->dot == 2) {
+            if(list->token_pointer == NULL || strcmp(list->token_pointer->value, ")") != 0)
+                error_handle(stderr, "dotted pair missing closing ')'", EXIT_FAILURE);
+            list_iter(list);
+            if(is_empty_list(top->head))
+                datum = top->rest;
+            else {
+                set_cdr(top->tail, top->rest);
+                datum = top->head;
+            }
+            count--;
+        }
+        else {
+            if(list->token_pointer == NULL) {
+                if(top == NULL)
+                    error_handle(stderr, "unexpected EOF while reading", EXIT_FAILURE);
+                if(top->kind == READ_VECTOR)
+                    error_handle(stderr, "unexpected EOF while reading vector", EXIT_FAILURE);
+                error_handle(stderr, "unexpected EOF while reading list", EXIT_FAILURE);
+            }
+            token_value = list->token_pointer->value;
+
+            if(strcmp(token_value, "(") == 0) {
+                list_iter(list);
+                push_read_frame(&count, READ_LIST);
+                continue;
+            }
+            if(strcmp(token_value, "#(") == 0) {
+                list_iter(list);
+                push_read_frame(&count, READ_VECTOR);
+                continue;
+            }
+            if(is_quotation(token_value, &quotation)) {
+                list_iter(list);
+                if(list->token_pointer == NULL)
+                    error_handle(stderr, quotations[quotation].missing, EXIT_FAILURE);
+                push_read_frame(&count, READ_QUOTE)->quote = quotation_symbol(quotation);
+                continue;
+            }
+
+            if(top != NULL && top->kind != READ_QUOTE && top->dot == 0 &&
+               strcmp(token_value, ")") == 0) {
+                list_iter(list);
+                datum = top->kind == READ_VECTOR ?
+                        list_to_vector(top->head, top->length) :
+                        top->head;
+                count--;
+            }
+            else if(top != NULL && top->kind == READ_LIST && top->dot == 0 &&
+                    strcmp(token_value, ".") == 0) {
+                list_iter(list);
+                if(list->token_pointer == NULL)
+                    error_handle(stderr, "dotted pair missing cdr", EXIT_FAILURE);
+                top->dot = 1;
+                continue;
+            }
+            else
+                datum = parse_atom(list);
+        }
+
+        /* hands the datum to what it is inside of */
+        for(;;) {
+            read_frame* frame;
 
-    object * car, * cdr;
-    car = parse(list);
-    cdr = parse_pair(list);
-    return cons(car, cdr);
+            if(count == 0)
+                return datum;
+            frame = &read_stack[count - 1];
+            if(frame->kind == READ_QUOTE) {
+                datum = cons(frame->quote, cons(datum, the_empty_list));
+                count--;
+                continue;
+            }
+            if(frame->dot == 1) {
+                frame->rest = datum;
+                frame->dot = 2;
+            }
+            else {
+                object* cell = cons(datum, the_empty_list);
+                if(is_empty_list(frame->head))
+                    frame->head = cell;
+                else
+                    set_cdr(frame->tail, cell);
+                frame->tail = cell;
+                frame->length++;
+            }
+            break;
+        }
+    }
 }
 
 bool is_str_digit(char* str) {
@@ -591,7 +689,8 @@ bool is_str_symbol(char* str) {
        c == '<' ||
        c == '=' ||
        c == '?' ||
-       c == '!')
+       c == '!' ||
+       c == '_')
         return true;
     return false;
 }
@@ -601,19 +700,8 @@ void list_iter(token_list* list) {
 }
 
 object* parse_string(char* str) {
-    size_t str_len = strlen(str);
-    char* s = (char*) malloc((str_len - 1) * sizeof(char));
-    object* string_obj;
-    if(s == NULL)
-        error_handle(stderr, "out of memory", EXIT_FAILURE);
-
-    for(size_t i = 0; i < str_len - 2; i++)
-        s[i] = str[i + 1];
-    s[str_len - 2] = '\0';
-
-    string_obj = make_string(s);
-    free(s);
-    return string_obj;
+    /* drop the surrounding quotes */
+    return make_sized_string(str + 1, strlen(str) - 2);
 }
 
 static object* parse_character(const char* token_value) {
@@ -628,18 +716,6 @@ static object* parse_character(const char* token_value) {
     return NULL;
 }
 
-static object* parse_vector_elements(token_list* list, size_t* length) {
-    if(list->token_pointer == NULL)
-        error_handle(stderr, "unexpected EOF while reading vector", EXIT_FAILURE);
-    if(strcmp(list->token_pointer->value, ")") == 0) {
-        list_iter(list);
-        return the_empty_list;
-    }
-
-    *length += 1;
-    return cons(parse(list), parse_vector_elements(list, length));
-}
-
 object* reader(FILE* in) {
     while(true) {
         char* pre_buf = read_source(in);
@@ -0,0 +1,1247 @@
+//
+// bytecode compiler and virtual machine
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "header/vm.h"
+#include "header/object.h"
+#include "header/analyze.h"
+#include "header/eval.h"
+#include "header/environment.h"
+#include "header/builtin.h"
+#include "header/error.h"
+#include "header/gc.h"
+
+/*
+ * Instructions are 32-bit words, the opcode in the low byte and its
+ * operand in the upper 24 bits. Operands are either an index into the
+ * constant vector of the code object, an argument count or an absolute
+ * jump target. The local variable instructions are followed by a second
+ * word holding the lexical address, see analyze.h. MACRO_CHECK is
+ * followed by a second word holding the target to continue at when the
+ * operator was a macro.
+ */
+#define VM_OPCODES(X) \
+    X(CONST)               /* push constant k */ \
+    X(LOOKUP)              /* push the value of top level variable k */ \
+    X(LOOKUP_LOCAL)        /* push the value of the local variable k */ \
+    X(SET)                 /* set! variable k to the popped value */ \
+    X(SET_LOCAL) \
+    X(DEFINE)              /* define variable k as the popped value */ \
+    X(DEFINE_LOCAL) \
+    X(DEFINE_SYNTAX)       /* run the define-syntax form k */ \
+    X(CLOSURE)             /* push a procedure for the lambda node k */ \
+    X(POP) \
+    X(JUMP) \
+    X(JUMP_IF_FALSE)       /* pop, jump when false */ \
+    X(JUMP_IF_FALSE_KEEP)  /* jump keeping a false value, else pop */ \
+    X(JUMP_IF_TRUE_KEEP)   /* jump keeping a true value, else pop */ \
+    X(MACRO_CHECK)         /* expand application k if its operator is a macro */ \
+    X(TAIL_MACRO_CHECK) \
+    X(CALL)                /* call with n arguments */ \
+    X(TAIL_CALL) \
+    X(RETURN) \
+    X(CONS)                /* quasiquote: push (cons item tail) */ \
+    X(APPEND)              /* quasiquote: push a copy of item before tail */ \
+    X(LIST_TO_VECTOR) \
+    X(APPLY_LIST)          /* tail call the procedure below the argument list */ \
+    X(CONTINUATION_RETURN) /* return from call/cc */ \
+    X(MAP_STEP) \
+    X(MAP_COLLECT) \
+    X(FOR_EACH_STEP) \
+    X(ERROR)               /* report message k */ \
+    X(INVALID)             /* report the unknown expression k */
+
+#define VM_OPCODE_ENUM(name) OP_##name,
+typedef enum {VM_OPCODES(VM_OPCODE_ENUM)} vm_opcode;
+#undef VM_OPCODE_ENUM
+
+#define OPERAND_SHIFT 8
+#define INSTRUCTION(op, operand) ((uint32_t)(op) | ((uint32_t)(operand) << OPERAND_SHIFT))
+#define OPCODE(word)  ((word) & 0xff)
+#define OPERAND(word) ((word) >> OPERAND_SHIFT)
+
+/*
+ * A frame is pushed for every call that has to come back: the caller's
+ * code, pc, environment and frame pointer. pc and frame pointer are
+ * stored as fixnums, an entry frame, the bottom frame of one vm_run,
+ * has the empty list in its pc slot instead. Locals of the built-in
+ * loops (map, for-each, call/cc) follow their frame.
+ */
+#define FRAME_SIZE 4
+#define FRAME_CODE 0
+#define FRAME_PC   1
+#define FRAME_ENV  2
+#define FRAME_FP   3
+
+/* headroom above the instructions of the running code, each of which
+ * pushes at most one slot, for the next frame and its locals */
+#define VM_STACK_SLACK 16
+#define VM_STACK_INITIAL 1024
+
+#define small_fixnum(value) ((object*) (((uintptr_t)(value) << 1) | FIXNUM_TAG))
+#define small_fixnum_value(obj) ((size_t) ((uintptr_t)(obj) >> 1))
+#define has_type(obj, t) (!is_immediate(obj) && (obj)->type == (t))
+
+/* one activation of the interpreter loop, a C level vm_eval or vm_apply */
+struct vm_run {
+    jmp_buf escape;           /* continuations of this run land here */
+    size_t base;              /* stack index of the entry frame */
+    size_t root_count;
+    struct vm_run* outer;
+};
+
+bool vm_enabled = true;
+size_t vm_stack_top = 0;
+
+static object** stack = NULL;
+static size_t stack_capacity = 0;
+
+/* the registers of the running code, stored before every safepoint */
+static object* vm_code = NULL;
+static object* vm_env = NULL;
+
+static struct vm_run* current_run = NULL;
+
+/* continuations whose call/cc frame is still on the stack, oldest first */
+static object** active_points = NULL;
+static size_t active_count = 0;
+static size_t active_capacity = 0;
+
+static object* escape_continuation = NULL;
+static object* escape_value = NULL;
+
+static object* apply_primitive = NULL;
+static object* map_primitive = NULL;
+static object* for_each_primitive = NULL;
+static object* call_cc_primitive = NULL;
+
+static object* apply_code = NULL;
+static object* map_code = NULL;
+static object* for_each_code = NULL;
+static object* call_cc_code = NULL;
+
+/**** compiler ****/
+
+typedef struct compiler {
+    uint32_t* instructions;
+    size_t length;
+    size_t capacity;
+    object** constants;
+    size_t constant_count;
+    size_t constant_capacity;
+} compiler;
+
+static void compile_node(compiler* c, object* node, bool tail);
+static void compile_quasiquote(compiler* c, object* template_exp, int depth);
+
+static size_t emit(compiler* c, vm_opcode op, size_t operand) {
+    if(c->length == c->capacity) {
+        c->capacity = c->capacity == 0 ? 32 : c->capacity * 2;
+        c->instructions = realloc(c->instructions, c->capacity * sizeof(uint32_t));
+        if(c->instructions == NULL)
+            error_handle(stderr, "cannot allocate bytecode", EXIT_FAILURE);
+    }
+    c->instructions[c->length] = INSTRUCTION(op, operand);
+    return c->length++;
+}
+
+static void patch(compiler* c, size_t at, size_t target) {
+    c->instructions[at] = INSTRUCTION(OPCODE(c->instructions[at]), target);
+}
+
+static size_t add_constant(compiler* c, object* value) {
+    for(size_t i = 0; i < c->constant_count; i++)
+        if(c->constants[i] == value)
+            return i;
+    if(c->constant_count == c->constant_capacity) {
+        c->constant_capacity = c->constant_capacity == 0 ? 8 : c->constant_capacity * 2;
+        c->constants = realloc(c->constants, c->constant_capacity * sizeof(object*));
+        if(c->constants == NULL)
+            error_handle(stderr, "cannot allocate bytecode", EXIT_FAILURE);
+    }
+    c->constants[c->constant_count] = value;
+    return c->constant_count++;
+}
+
+static void emit_constant(compiler* c, vm_opcode op, object* value) {
+    emit(c, op, add_constant(c, value));
+}
+
+/* a variable instruction and the address or depth word that follows it */
+static void emit_variable(compiler* c, vm_opcode op, object* node) {
+    emit_constant(c, op, node->data.node.first);
+    emit(c, 0, 0);
+    c->instructions[c->length - 1] = (uint32_t) fixnum_value(node->data.node.third);
+}
+
+static void emit_return(compiler* c, bool tail) {
+    if(tail)
+        emit(c, OP_RETURN, 0);
+}
+
+/* and/or: every test but the last may leave the result and jump out */
+static void compile_short_circuit(compiler* c, object* tests, vm_opcode jump, bool tail) {
+    size_t last = tests->data.vector.length - 1;
+    size_t* exits = malloc(last * sizeof(size_t) + 1);
+
+    for(size_t i = 0; i < last; i++) {
+        compile_node(c, tests->data.vector.elements[i], false);
+        exits[i] = emit(c, jump, 0);
+    }
+    compile_node(c, tests->data.vector.elements[last], tail);
+    for(size_t i = 0; i < last; i++)
+        patch(c, exits[i], c->length);
+    free(exits);
+    emit_return(c, tail && last > 0);
+}
+
+static void compile_application(compiler* c, object* node, bool tail) {
+    object* operator_node = node->data.node.first;
+    object* operands = application_operands(node);
+    size_t check = 0;
+    bool may_be_macro = is_variable_node(operator_node);
+
+    compile_node(c, operator_node, false);
+    if(may_be_macro) {
+        if(tail)
+            emit_constant(c, OP_TAIL_MACRO_CHECK, node);
+        else {
+            emit_constant(c, OP_MACRO_CHECK, node);
+            check = emit(c, 0, 0);
+        }
+    }
+    for(size_t i = 0; i < operands->data.vector.length; i++)
+        compile_node(c, operands->data.vector.elements[i], false);
+    emit(c, tail ? OP_TAIL_CALL : OP_CALL, operands->data.vector.length);
+    if(may_be_macro && !tail)
+        c->instructions[check] = (uint32_t) c->length;
+}
+
+static void compile_node(compiler* c, object* node, bool tail) {
+    object* first = node->data.node.first;
+
+    switch(node->data.node.kind) {
+        case NODE_CONSTANT:
+            emit_constant(c, OP_CONST, first);
+            emit_return(c, tail);
+            break;
+        case NODE_VARIABLE:
+            emit_constant(c, OP_LOOKUP, first);
+            emit_return(c, tail);
+            break;
+        case NODE_LOCAL_VARIABLE:
+            emit_variable(c, OP_LOOKUP_LOCAL, node);
+            emit_return(c, tail);
+            break;
+        case NODE_QUASIQUOTE:
+            compile_quasiquote(c, first, 1);
+            emit_return(c, tail);
+            break;
+        case NODE_ASSIGNMENT:
+            compile_node(c, node->data.node.second, false);
+            emit_constant(c, OP_SET, first);
+            emit_return(c, tail);
+            break;
+        case NODE_LOCAL_ASSIGNMENT:
+            compile_node(c, node->data.node.second, false);
+            emit_variable(c, OP_SET_LOCAL, node);
+            emit_return(c, tail);
+            break;
+        case NODE_DEFINITION:
+            compile_node(c, node->data.node.second, false);
+            emit_constant(c, OP_DEFINE, first);
+            emit_return(c, tail);
+            break;
+        case NODE_LOCAL_DEFINITION:
+            compile_node(c, node->data.node.second, false);
+            emit_variable(c, OP_DEFINE_LOCAL, node);
+            emit_return(c, tail);
+            break;
+        case NODE_DEFINE_SYNTAX:
+            emit_constant(c, OP_DEFINE_SYNTAX, first);
+            emit_return(c, tail);
+            break;
+        case NODE_IF: {
+            size_t to_alternative;
+            size_t to_end = 0;
+
+            compile_node(c, first, false);
+            to_alternative = emit(c, OP_JUMP_IF_FALSE, 0);
+            compile_node(c, node->data.node.second, tail);
+            if(!tail)
+                to_end = emit(c, OP_JUMP, 0);
+            patch(c, to_alternative, c->length);
+            compile_node(c, node->data.node.third, tail);
+            if(!tail)
+                patch(c, to_end, c->length);
+            break;
+        }
+        case NODE_LAMBDA:
+            emit_constant(c, OP_CLOSURE, node);
+            emit_return(c, tail);
+            break;
+        case NODE_SEQUENCE: {
+            size_t last = first->data.vector.length - 1;
+            for(size_t i = 0; i < last; i++) {
+                compile_node(c, first->data.vector.elements[i], false);
+                emit(c, OP_POP, 0);
+            }
+            compile_node(c, first->data.vector.elements[last], tail);
+            break;
+        }
+        case NODE_AND:
+            compile_short_circuit(c, first, OP_JUMP_IF_FALSE_KEEP, tail);
+            break;
+        case NODE_OR:
+            compile_short_circuit(c, first, OP_JUMP_IF_TRUE_KEEP, tail);
+            break;
+        case NODE_APPLICATION:
+            compile_application(c, node, tail);
+            break;
+        case NODE_ERROR:
+            emit_constant(c, OP_ERROR, first);
+            break;
+        case NODE_INVALID:
+            emit_constant(c, OP_INVALID, first);
+            break;
+    }
+}
+
+/* pushes (tag value) where value is the template at the given depth */
+static void compile_quasiquote_wrap(compiler* c, object* tag, object* template_exp, int depth) {
+    emit_constant(c, OP_CONST, tag);
+    compile_quasiquote(c, template_exp, depth);
+    emit_constant(c, OP_CONST, the_empty_list);
+    emit(c, OP_CONS, 0);
+    emit(c, OP_CONS, 0);
+}
+
+/*
+ * The items of a template list are pushed left to right, then its tail,
+ * and the list is built back to front by CONS for plain items and by
+ * APPEND for depth 1 unquote-splicing.
+ */
+static void compile_quasiquote_list(compiler* c, object* template_exp, int depth) {
+    object* items = template_exp;
+    size_t count = 0;
+    bool* spliced;
+
+    for(; is_pair(items); items = cdr(items))
+        count++;
+    spliced = malloc(count * sizeof(bool) + 1);
+
+    items = template_exp;
+    for(size_t i = 0; i < count; i++, items = cdr(items)) {
+        object* item = car(items);
+        spliced[i] = depth == 1 && is_tagged_list(item, unquote_splicing_symbol);
+        if(spliced[i])
+            compile_node(c, cadr(item), false);
+        else
+            compile_quasiquote(c, item, depth);
+    }
+    if(is_empty_list(items))
+        emit_constant(c, OP_CONST, the_empty_list);
+    else
+        compile_quasiquote(c, items, depth);
+
+    while(count > 0) {
+        count--;
+        emit(c, spliced[count] ? OP_APPEND : OP_CONS, 0);
+    }
+    free(spliced);
+}
+
+static void compile_quasiquote(compiler* c, object* template_exp, int depth) {
+    if(is_pair(template_exp)) {
+        if(is_tagged_list(template_exp, unquote_symbol)) {
+            if(depth == 1)
+                compile_node(c, cadr(template_exp), false);
+            else
+                compile_quasiquote_wrap(c, unquote_symbol, cadr(template_exp), depth - 1);
+        }
+        else if(is_tagged_list(template_exp, unquote_splicing_symbol)) {
+            if(depth == 1)
+                emit_constant(c, OP_ERROR,
+                              make_string("unquote-splicing cannot appear here"));
+            else
+                compile_quasiquote_wrap(c, unquote_splicing_symbol, cadr(template_exp), depth - 1);
+        }
+        else if(is_tagged_list(template_exp, quasiquote_symbol))
+            compile_quasiquote_wrap(c, quasiquote_symbol, cadr(template_exp), depth + 1);
+        else
+            compile_quasiquote_list(c, template_exp, depth);
+    }
+    else if(is_vector(template_exp)) {
+        compile_quasiquote_list(c, vector_to_list(template_exp), depth);
+        emit(c, OP_LIST_TO_VECTOR, 0);
+    }
+    else
+        emit_constant(c, OP_CONST, template_exp);
+}
+
+static object* finish_code(compiler* c) {
+    object* constants = make_vector(c->constant_count, the_empty_list);
+    object* code;
+
+    memcpy(constants->data.vector.elements, c->constants, c->constant_count * sizeof(object*));
+    code = make_code(c->length, constants);
+    memcpy(code->data.code.instructions, c->instructions, c->length * sizeof(uint32_t));
+    free(c->instructions);
+    free(c->constants);
+    return code;
+}
+
+/* compiles a node in tail position, its code ends with a RETURN */
+static object* compile(object* node) {
+    compiler c = {NULL, 0, 0, NULL, 0, 0};
+    compile_node(&c, node, true);
+    return finish_code(&c);
+}
+
+/* the code of the expansion of a macro use, compiled once per expansion */
+static object* macro_code(object* application, object* macro) {
+    object* expansion = macro_expansion(application, macro);
+    if(expansion->data.node.code == NULL) {
+        expansion->data.node.code = compile(expansion);
+        gc_write_barrier(expansion, expansion->data.node.code);
+    }
+    return expansion->data.node.code;
+}
+
+static object* make_builtin_code(const uint32_t* instructions, size_t length) {
+    object* code = make_code(length, make_vector(0, the_empty_list));
+    memcpy(code->data.code.instructions, instructions, length * sizeof(uint32_t));
+    return code;
+}
+
+/**** runtime support ****/
+
+static object** grow_stack(object** sp, size_t needed) {
+    size_t top = (size_t) (sp - stack);
+    size_t capacity = stack_capacity == 0 ? VM_STACK_INITIAL : stack_capacity;
+
+    while(capacity - top < needed)
+        capacity *= 2;
+    stack = realloc(stack, capacity * sizeof(object*));
+    if(stack == NULL)
+        error_handle(stderr, "VM stack overflow", EXIT_FAILURE);
+    stack_capacity = capacity;
+    return stack + top;
+}
+
+static void reserve_points(size_t count) {
+    if(active_capacity - active_count >= count)
+        return;
+    if(active_capacity == 0)
+        active_capacity = 16;
+    while(active_capacity - active_count < count)
+        active_capacity *= 2;
+    active_points = realloc(active_points, active_capacity * sizeof(object*));
+    if(active_points == NULL)
+        error_handle(stderr, "cannot allocate continuation", EXIT_FAILURE);
+}
+
+/* the call/cc frame of continuation is live at frame of the running run */
+static void enter_point(object* continuation, size_t frame) {
+    continuation_point* point = continuation->data.continuation.point;
+
+    point->active = true;
+    point->run = current_run;
+    point->frame = frame;
+    point->root_count = current_run->root_count;
+}
+
+static void activate_point(object* continuation, size_t frame) {
+    reserve_points(1);
+    enter_point(continuation, frame);
+    active_points[active_count++] = continuation;
+}
+
+/* ends every continuation whose call/cc frame is at or above frame */
+static void deactivate_points(size_t frame) {
+    while(active_count > 0 &&
+          active_points[active_count - 1]->data.continuation.point->frame >= frame)
+        active_points[--active_count]->data.continuation.point->active = false;
+}
+
+/*
+ * A continuation keeps a copy of the stack above the entry frame of its
+ * run, up to and including the continuation slot of its call/cc frame,
+ * so it can be called again after that frame is gone. The slots below
+ * the newest active call/cc of the same run are still exactly what that
+ * continuation copied, so only the slots above it are copied and the
+ * rest is shared through parent: capturing inside a generator or a loop
+ * costs the frames since the enclosing call/cc, not the whole stack.
+ * Frame pointers in the copy are relative to the entry frame.
+ */
+static void save_frames(object* continuation, size_t frame) {
+    size_t base = current_run->base;
+    size_t start = base + FRAME_SIZE;
+    size_t top = frame + FRAME_SIZE + 1;
+    object* parent = NULL;
+    object* frames;
+
+    if(active_count > 0 &&
+       active_points[active_count - 1]->data.continuation.point->run == current_run) {
+        parent = active_points[active_count - 1];
+        start += parent->data.continuation.point->height;
+    }
+    frames = make_vector(top - start, the_empty_list);
+    memcpy(frames->data.vector.elements, stack + start, (top - start) * sizeof(object*));
+    for(size_t f = frame; f >= start; f = small_fixnum_value(stack[f + FRAME_FP]))
+        frames->data.vector.elements[f - start + FRAME_FP] =
+            small_fixnum(small_fixnum_value(stack[f + FRAME_FP]) - base);
+
+    continuation->data.continuation.parent = parent;
+    continuation->data.continuation.frames = frames;
+    gc_write_barrier(continuation, parent);
+    gc_write_barrier(continuation, frames);
+    continuation->data.continuation.point->height = top - base - FRAME_SIZE;
+}
+
+/*
+ * Puts the frames of continuation back above the entry frame at base,
+ * replacing everything the run has pushed, and returns the frame of its
+ * call/cc. The call/cc frames that come back become active again unless
+ * they still are in an outer run.
+ */
+static size_t restore_frames(object* continuation, size_t base) {
+    size_t height = continuation->data.continuation.point->height;
+    size_t frame = base + height - 1;
+    size_t needed = base + FRAME_SIZE + height + VM_STACK_SLACK;
+    size_t chain = 0;
+    size_t kept = active_count;
+
+    if(stack_capacity < needed)
+        grow_stack(stack + base, needed - base);
+    for(object* c = continuation; c != NULL; c = c->data.continuation.parent) {
+        object* frames = c->data.continuation.frames;
+        size_t length = frames->data.vector.length;
+
+        memcpy(stack + base + FRAME_SIZE + c->data.continuation.point->height - length,
+               frames->data.vector.elements, length * sizeof(object*));
+        chain++;
+    }
+
+    /* frame pointers become absolute again, and every frame returned to
+     * needs room for the code it resumes */
+    for(size_t f = frame; f != base; f = small_fixnum_value(stack[f + FRAME_FP])) {
+        size_t resumed = f + stack[f + FRAME_CODE]->data.code.length + VM_STACK_SLACK;
+
+        stack[f + FRAME_FP] = small_fixnum(small_fixnum_value(stack[f + FRAME_FP]) + base);
+        if(resumed > needed)
+            needed = resumed;
+    }
+    if(stack_capacity < needed)
+        grow_stack(stack + base, needed - base);
+
+    /* the chain runs newest first, the active points oldest first */
+    reserve_points(chain);
+    for(object* c = continuation; c != NULL; c = c->data.continuation.parent) {
+        chain--;
+        if(c->data.continuation.point->active) {
+            active_points[active_count + chain] = NULL;
+            continue;
+        }
+        enter_point(c, base + c->data.continuation.point->height - 1);
+        active_points[active_count + chain] = c;
+    }
+    for(object* c = continuation; c != NULL; c = c->data.continuation.parent, chain++)
+        if(active_points[active_count + chain] != NULL)
+            active_points[kept++] = active_points[active_count + chain];
+    active_count = kept;
+    return frame;
+}
+
+static size_t list_length(object* list) {
+    size_t length = 0;
+    for(; is_pair(list); list = cdr(list))
+        length++;
+    return length;
+}
+
+static void native_error(const char* proc_name, const char* message) {
+    char error_buf[256];
+    snprintf(error_buf, sizeof(error_buf), "%s: %s", proc_name, message);
+    error_handle(stderr, error_buf, EXIT_FAILURE);
+}
+
+static void require_min_arguments(const char* proc_name, object* arguments, size_t minimum) {
+    size_t count = list_length(arguments);
+    if(count < minimum) {
+        char error_buf[128];
+        snprintf(error_buf, sizeof(error_buf), "expected at least %zu args, got %zu", minimum, count);
+        native_error(proc_name, error_buf);
+    }
+}
+
+/* the arguments of (apply f a ... list) as one list, f is left in *procedure */
+static object* spread_arguments(object* arguments, object** procedure) {
+    object* head = the_empty_list;
+    object* tail = the_empty_list;
+    object* last;
+
+    require_min_arguments("apply", arguments, 2);
+    *procedure = car(arguments);
+    arguments = cdr(arguments);
+
+    while(is_pair(cdr(arguments))) {
+        object* cell = cons(car(arguments), the_empty_list);
+        if(is_empty_list(head))
+            head = cell;
+        else
+            set_cdr(tail, cell);
+        tail = cell;
+        arguments = cdr(arguments);
+    }
+
+    last = car(arguments);
+    if(!is_empty_list(last) && !is_pair(last))
+        native_error("apply", "last arg must be list");
+    if(is_empty_list(head))
+        return last;
+    set_cdr(tail, last);
+    return head;
+}
+
+static object* copy_list(object* list) {
+    object* head = the_empty_list;
+    object* tail = the_empty_list;
+
+    for(; is_pair(list); list = cdr(list)) {
+        object* cell = cons(car(list), the_empty_list);
+        if(is_empty_list(head))
+            head = cell;
+        else
+            set_cdr(tail, cell);
+        tail = cell;
+    }
+    return head;
+}
+
+static object* reverse_list(object* list) {
+    object* reversed = the_empty_list;
+
+    for(; is_pair(list); list = cdr(list))
+        reversed = cons(car(list), reversed);
+    return reversed;
+}
+
+/*
+ * The arguments of the next step of map or for-each from the lists in
+ * the local at slot, which is replaced by the advanced lists rather than
+ * advanced in place: a continuation captured during one step keeps the
+ * lists of that step.
+ */
+static object* next_step_arguments(const char* proc_name, size_t slot) {
+    object* lists = copy_list(stack[slot]);
+    object* arguments = next_map_arguments(proc_name, lists);
+
+    stack[slot] = lists;
+    return arguments;
+}
+
+/* a fresh copy of the proper list items followed by tail */
+static object* append_copy(object* items, object* tail) {
+    object* head = the_empty_list;
+    object* last = the_empty_list;
+
+    for(; is_pair(items); items = cdr(items)) {
+        object* cell = cons(car(items), the_empty_list);
+        if(is_empty_list(head))
+            head = cell;
+        else
+            set_cdr(last, cell);
+        last = cell;
+    }
+    if(!is_empty_list(items))
+        error_handle(stderr, "unquote-splicing requires a proper list", EXIT_FAILURE);
+    if(is_empty_list(head))
+        return tail;
+    set_cdr(last, tail);
+    return head;
+}
+
+static object* make_vector_from_list(object* list) {
+    size_t length = 0;
+    object* cursor = list;
+
+    for(; is_pair(cursor); cursor = cdr(cursor))
+        length++;
+    if(!is_empty_list(cursor))
+        error_handle(stderr, "quasiquote vector must remain proper", EXIT_FAILURE);
+    return list_to_vector(list, length);
+}
+
+/**** interpreter ****/
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define TARGET(op) target_##op:
+#define NEXT() \
+    do { \
+        word = *ip++; \
+        goto *dispatch_table[OPCODE(word)]; \
+    } while(0)
+#else
+#define TARGET(op) case OP_##op:
+#define NEXT() goto dispatch
+#endif
+
+#define SET_CODE(new_code, pc) \
+    do { \
+        code = (new_code); \
+        ip = code->data.code.instructions + (pc); \
+        constants = code->data.code.constants->data.vector.elements; \
+    } while(0)
+
+#define RESERVE(slots) \
+    do { \
+        if((size_t) (stack + stack_capacity - sp) < (slots)) \
+            sp = grow_stack(sp, (slots)); \
+    } while(0)
+
+#define RESERVE_CODE() RESERVE(code->data.code.length + VM_STACK_SLACK)
+
+#define PUSH_FRAME() \
+    do { \
+        sp[FRAME_CODE] = code; \
+        sp[FRAME_PC] = small_fixnum(ip - code->data.code.instructions); \
+        sp[FRAME_ENV] = env; \
+        sp[FRAME_FP] = small_fixnum(fp); \
+        fp = (size_t) (sp - stack); \
+        sp += FRAME_SIZE; \
+    } while(0)
+
+/* a tail call reuses the frame of the caller */
+#define ENTER_FRAME() \
+    do { \
+        if(tail) \
+            sp = stack + fp + FRAME_SIZE; \
+        else \
+            PUSH_FRAME(); \
+    } while(0)
+
+#define SAVE_STATE() \
+    do { \
+        vm_code = code; \
+        vm_env = env; \
+        vm_stack_top = (size_t) (sp - stack); \
+    } while(0)
+
+#define SAFEPOINT() \
+    do { \
+        SAVE_STATE(); \
+        gc_safepoint(); \
+    } while(0)
+
+/*
+ * Runs code in env until the entry frame pushed here is returned to.
+ * When procedure is given it is pushed together with arguments for the
+ * APPLY_LIST code.
+ */
+static object* run(object* start, object* start_env, object* procedure, object* arguments) {
+#ifdef VM_COMPUTED_GOTO
+#define VM_OPCODE_LABEL(name) &&target_##name,
+    static void* dispatch_table[] = {VM_OPCODES(VM_OPCODE_LABEL)};
+#undef VM_OPCODE_LABEL
+#endif
+    struct vm_run run;
+    object* code;
+    object* env = start_env;
+    object** constants;
+    const uint32_t* ip;
+    object** sp;
+    size_t fp;
+    uint32_t word;
+    object* value;
+    size_t target;
+    bool tail;
+
+    sp = stack + vm_stack_top;
+    RESERVE(start->data.code.length + VM_STACK_SLACK + FRAME_SIZE + 2);
+
+    run.base = (size_t) (sp - stack);
+    run.root_count = gc_root_count;
+    run.outer = current_run;
+    current_run = &run;
+
+    sp[FRAME_CODE] = vm_code;
+    sp[FRAME_PC] = the_empty_list;
+    sp[FRAME_ENV] = vm_env;
+    sp[FRAME_FP] = small_fixnum(0);
+    fp = run.base;
+    sp += FRAME_SIZE;
+    if(procedure != NULL) {
+        *sp++ = procedure;
+        *sp++ = arguments;
+    }
+    SET_CODE(start, 0);
+
+    if(setjmp(run.escape) != 0) {
+        /* a continuation captured by this run was called from a nested one */
+        current_run = &run;
+        gc_root_count = run.root_count;
+        value = escape_value;
+        target = escape_continuation->data.continuation.point->frame;
+        escape_continuation = NULL;
+        escape_value = NULL;
+        env = vm_env;
+        goto escape;
+    }
+
+    NEXT();
+
+#ifndef VM_COMPUTED_GOTO
+dispatch:
+    word = *ip++;
+    switch(OPCODE(word)) {
+#endif
+
+    TARGET(CONST) {
+        *sp++ = constants[OPERAND(word)];
+        NEXT();
+    }
+
+    TARGET(LOOKUP) {
+        *sp++ = lookup_global_value(constants[OPERAND(word)], env);
+        NEXT();
+    }
+
+    TARGET(LOOKUP_LOCAL) {
+        *sp++ = lookup_lexical_value(constants[OPERAND(word)], *ip++, env);
+        NEXT();
+    }
+
+    TARGET(SET) {
+        set_global_value(constants[OPERAND(word)], sp[-1], env);
+        sp[-1] = ok_symbol;
+        NEXT();
+    }
+
+    TARGET(SET_LOCAL) {
+        set_lexical_value(constants[OPERAND(word)], *ip++, sp[-1], env);
+        sp[-1] = ok_symbol;
+        NEXT();
+    }
+
+    TARGET(DEFINE) {
+        define_variable(constants[OPERAND(word)], sp[-1], env);
+        sp[-1] = ok_symbol;
+        NEXT();
+    }
+
+    TARGET(DEFINE_LOCAL) {
+        define_lexical_value(*ip++, sp[-1], env);
+        sp[-1] = ok_symbol;
+        NEXT();
+    }
+
+    TARGET(DEFINE_SYNTAX) {
+        *sp++ = eval_define_syntax(constants[OPERAND(word)], env);
+        NEXT();
+    }
+
+    TARGET(CLOSURE) {
+        *sp++ = make_closure(constants[OPERAND(word)], env);
+        NEXT();
+    }
+
+    TARGET(POP) {
+        sp--;
+        NEXT();
+    }
+
+    TARGET(JUMP) {
+        ip = code->data.code.instructions + OPERAND(word);
+        NEXT();
+    }
+
+    TARGET(JUMP_IF_FALSE) {
+        if(*--sp == false_obj)
+            ip = code->data.code.instructions + OPERAND(word);
+        NEXT();
+    }
+
+    TARGET(JUMP_IF_FALSE_KEEP) {
+        if(sp[-1] == false_obj)
+            ip = code->data.code.instructions + OPERAND(word);
+        else
+            sp--;
+        NEXT();
+    }
+
+    TARGET(JUMP_IF_TRUE_KEEP) {
+        if(sp[-1] != false_obj)
+            ip = code->data.code.instructions + OPERAND(word);
+        else
+            sp--;
+        NEXT();
+    }
+
+    TARGET(MACRO_CHECK) {
+        if(has_type(sp[-1], MACRO)) {
+            object* expansion = macro_code(constants[OPERAND(word)], *--sp);
+            ip = code->data.code.instructions + *ip;
+            PUSH_FRAME();
+            SET_CODE(expansion, 0);
+            RESERVE_CODE();
+        }
+        else
+            ip++;
+        NEXT();
+    }
+
+    TARGET(TAIL_MACRO_CHECK) {
+        if(has_type(sp[-1], MACRO)) {
+            object* expansion = macro_code(constants[OPERAND(word)], *--sp);
+            sp = stack + fp + FRAME_SIZE;
+            SET_CODE(expansion, 0);
+            RESERVE_CODE();
+        }
+        NEXT();
+    }
+
+    TARGET(CALL) {
+        tail = false;
+        goto collect_arguments;
+    }
+
+    TARGET(TAIL_CALL) {
+        tail = true;
+    collect_arguments:
+        procedure = sp[-(ptrdiff_t) OPERAND(word) - 1];
+        if(has_type(procedure, COMPOUND_PROC)) {
+            /* the frame is filled straight from the stack */
+            object* frame = extend_procedure_environment_argv(procedure, OPERAND(word),
+                                                              sp - OPERAND(word));
+            sp -= OPERAND(word) + 1;
+            ENTER_FRAME();
+            env = frame;
+            goto enter_body;
+        }
+        if(has_type(procedure, PRIMITIVE_PROC) &&
+           procedure->data.primitive_proc.argv_fun != NULL) {
+            if(!primitive_arity_ok(procedure, OPERAND(word)))
+                primitive_arity_error(procedure, OPERAND(word));
+            if(OPERAND(word) == 2 && procedure->data.primitive_proc.binary_fun != NULL) {
+                /* never reaches a safepoint, so no state to save */
+                value = (procedure->data.primitive_proc.binary_fun)(sp[-2], sp[-1]);
+                sp -= 3;
+            }
+            else {
+                /* the arguments stay on the stack while the primitive runs */
+                SAVE_STATE();
+                value = (procedure->data.primitive_proc.argv_fun)(OPERAND(word), sp - OPERAND(word));
+                sp = stack + vm_stack_top - OPERAND(word) - 1;
+            }
+            if(tail)
+                goto do_return;
+            *sp++ = value;
+            NEXT();
+        }
+        arguments = the_empty_list;
+        for(size_t count = OPERAND(word); count > 0; count--)
+            arguments = cons(*--sp, arguments);
+        procedure = *--sp;
+
+    call:
+        if(has_type(procedure, COMPOUND_PROC)) {
+            object* body;
+
+            ENTER_FRAME();
+            env = extend_procedure_environment(procedure, arguments);
+        enter_body:
+            body = procedure->data.compound_proc.body;
+            if(body->data.node.code == NULL) {
+                body->data.node.code = compile(body);
+                gc_write_barrier(body, body->data.node.code);
+            }
+            SET_CODE(body->data.node.code, 0);
+            RESERVE_CODE();
+            SAFEPOINT();
+            NEXT();
+        }
+        else if(has_type(procedure, PRIMITIVE_PROC)) {
+            if(procedure == apply_primitive) {
+                arguments = spread_arguments(arguments, &procedure);
+                goto call;
+            }
+            if(procedure == map_primitive) {
+                require_min_arguments("map", arguments, 2);
+                ENTER_FRAME();
+                sp[0] = car(arguments);
+                sp[1] = cdr(arguments);
+                sp[2] = the_empty_list;
+                sp += 3;
+                SET_CODE(map_code, 0);
+                RESERVE_CODE();
+                NEXT();
+            }
+            if(procedure == for_each_primitive) {
+                require_min_arguments("for-each", arguments, 2);
+                ENTER_FRAME();
+                sp[0] = car(arguments);
+                sp[1] = cdr(arguments);
+                sp += 2;
+                SET_CODE(for_each_code, 0);
+                RESERVE_CODE();
+                NEXT();
+            }
+            if(procedure == call_cc_primitive) {
+                object* receiver;
+                object* continuation;
+                size_t count = list_length(arguments);
+
+                if(count != 1) {
+                    char error_buf[128];
+                    snprintf(error_buf, sizeof(error_buf), "expected 1 args, got %zu", count);
+                    native_error("call/cc", error_buf);
+                }
+                receiver = car(arguments);
+                if(!has_type(receiver, PRIMITIVE_PROC) && !has_type(receiver, COMPOUND_PROC))
+                    native_error("call/cc", "arg 1 must be procedure");
+
+                ENTER_FRAME();
+                continuation = make_continuation();
+                sp[0] = continuation;
+                save_frames(continuation, fp);
+                activate_point(continuation, fp);
+                sp[1] = receiver;
+                sp[2] = continuation;
+                sp += 3;
+                SET_CODE(call_cc_code, 0);
+                RESERVE_CODE();
+                NEXT();
+            }
+
+            /* the argument list stays on the stack while the primitive runs */
+            *sp = arguments;
+            sp++;
+            SAVE_STATE();
+            value = apply_primitive_procedure(procedure, arguments);
+            sp = stack + vm_stack_top - 1;
+            if(tail)
+                goto do_return;
+            *sp++ = value;
+            NEXT();
+        }
+        else if(has_type(procedure, CONTINUATION)) {
+            continuation_point* point = procedure->data.continuation.point;
+
+            if(!is_pair(arguments) || !is_empty_list(cdr(arguments)))
+                error_handle(stderr, "continuation expected exactly 1 value", EXIT_FAILURE);
+            value = car(arguments);
+            if(!point->active) {
+                if(procedure->data.continuation.frames == NULL)
+                    error_handle(stderr, "inactive continuation", EXIT_FAILURE);
+                /* re-entry: the frames come back from the copy */
+                deactivate_points(run.base);
+                gc_root_count = run.root_count;
+                target = restore_frames(procedure, run.base);
+                goto escape;
+            }
+            if(point->run == NULL) {
+                /* captured by the tree walking evaluator */
+                procedure->data.continuation.value = value;
+                gc_write_barrier(procedure, value);
+                gc_root_count = point->root_count;
+                longjmp(point->return_point, 1);
+            }
+            /* an escape to a live frame only unwinds the stack */
+            if(point->run != current_run) {
+                escape_continuation = procedure;
+                escape_value = value;
+                longjmp(point->run->escape, 1);
+            }
+            target = point->frame;
+            goto escape;
+        }
+        else {
+            error_handle_with_object(stderr,
+                                     "Unknown procedure type --EVAL",
+                                     EXIT_FAILURE,
+                                     procedure);
+        }
+        NEXT();
+    }
+
+    TARGET(RETURN) {
+        object** frame;
+
+        value = *--sp;
+    do_return:
+        frame = stack + fp;
+        if(frame[FRAME_PC] == the_empty_list) {
+            vm_code = frame[FRAME_CODE];
+            vm_env = frame[FRAME_ENV];
+            vm_stack_top = run.base;
+            current_run = run.outer;
+            return value;
+        }
+        env = frame[FRAME_ENV];
+        fp = small_fixnum_value(frame[FRAME_FP]);
+        SET_CODE(frame[FRAME_CODE], small_fixnum_value(frame[FRAME_PC]));
+        sp = frame;
+        *sp++ = value;
+        NEXT();
+    }
+
+    TARGET(CONS) {
+        object* rest = *--sp;
+        sp[-1] = cons(sp[-1], rest);
+        NEXT();
+    }
+
+    TARGET(APPEND) {
+        object* rest = *--sp;
+        sp[-1] = append_copy(sp[-1], rest);
+        NEXT();
+    }
+
+    TARGET(LIST_TO_VECTOR) {
+        sp[-1] = make_vector_from_list(sp[-1]);
+        NEXT();
+    }
+
+    TARGET(APPLY_LIST) {
+        arguments = *--sp;
+        procedure = *--sp;
+        tail = true;
+        goto call;
+    }
+
+    TARGET(CONTINUATION_RETURN) {
+        value = *--sp;
+        deactivate_points(fp);
+        goto do_return;
+    }
+
+    TARGET(MAP_STEP) {
+        SAFEPOINT();
+        arguments = next_step_arguments("map", fp + FRAME_SIZE + 1);
+        if(arguments == NULL) {
+            value = reverse_list(stack[fp + FRAME_SIZE + 2]);
+            goto do_return;
+        }
+        procedure = stack[fp + FRAME_SIZE];
+        tail = false;
+        goto call;
+    }
+
+    TARGET(MAP_COLLECT) {
+        /* results are collected in reverse, never by mutating a cell */
+        object* results = cons(*--sp, stack[fp + FRAME_SIZE + 2]);
+        stack[fp + FRAME_SIZE + 2] = results;
+        NEXT();
+    }
+
+    TARGET(FOR_EACH_STEP) {
+        SAFEPOINT();
+        arguments = next_step_arguments("for-each", fp + FRAME_SIZE + 1);
+        if(arguments == NULL) {
+            value = ok_symbol;
+            goto do_return;
+        }
+        procedure = stack[fp + FRAME_SIZE];
+        tail = false;
+        goto call;
+    }
+
+    TARGET(ERROR) {
+        error_handle(stderr, constants[OPERAND(word)]->data.string.value, EXIT_FAILURE);
+        NEXT();
+    }
+
+    TARGET(INVALID) {
+        error_handle_with_object(stderr,
+                                 "Unknown expression type --EVAL",
+                                 EXIT_FAILURE,
+                                 constants[OPERAND(word)]);
+        NEXT();
+    }
+
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+
+    /* an escape to the call/cc whose frame is at target, with value */
+escape:
+    deactivate_points(target + 1);
+    fp = target;
+    sp = stack + fp + FRAME_SIZE + 1;
+    *sp++ = value;
+    SET_CODE(call_cc_code, 1);
+    NEXT();
+}
+
+void vm_init(void) {
+    static const uint32_t apply_instructions[] = {
+        INSTRUCTION(OP_APPLY_LIST, 0)
+    };
+    static const uint32_t map_instructions[] = {
+        INSTRUCTION(OP_MAP_STEP, 0),
+        INSTRUCTION(OP_MAP_COLLECT, 0),
+        INSTRUCTION(OP_JUMP, 0)
+    };
+    static const uint32_t for_each_instructions[] = {
+        INSTRUCTION(OP_FOR_EACH_STEP, 0),
+        INSTRUCTION(OP_POP, 0),
+        INSTRUCTION(OP_JUMP, 0)
+    };
+    static const uint32_t call_cc_instructions[] = {
+        INSTRUCTION(OP_CALL, 1),
+        INSTRUCTION(OP_CONTINUATION_RETURN, 0)
+    };
+
+    apply_primitive = lookup_variable_value(make_symbol("apply"), the_global_environment);
+    map_primitive = lookup_variable_value(make_symbol("map"), the_global_environment);
+    for_each_primitive = lookup_variable_value(make_symbol("for-each"), the_global_environment);
+    call_cc_primitive = lookup_variable_value(make_symbol("call/cc"), the_global_environment);
+
+    apply_code = make_builtin_code(apply_instructions, 1);
+    map_code = make_builtin_code(map_instructions, 3);
+    for_each_code = make_builtin_code(for_each_instructions, 3);
+    call_cc_code = make_builtin_code(call_cc_instructions, 2);
+}
+
+object* vm_eval(object* exp, object* env) {
+    return run(compile(analyze(exp)), env, NULL, NULL);
+}
+
+object* vm_apply(object* procedure, object* arguments) {
+    return run(apply_code, the_empty_environment, procedure, arguments);
+}
+
+void vm_unwind(size_t height) {
+    deactivate_points(height);
+    while(current_run != NULL && current_run->base >= height)
+        current_run = current_run->outer;
+    vm_stack_top = height;
+}
+
+void vm_visit_roots(void (*visit)(object** slot)) {
+    for(size_t i = 0; i < vm_stack_top; i++)
+        visit(&stack[i]);
+    visit(&vm_code);
+    visit(&vm_env);
+    for(size_t i = 0; i < active_count; i++)
+        visit(&active_points[i]);
+    visit(&escape_continuation);
+    visit(&escape_value);
+    visit(&apply_primitive);
+    visit(&map_primitive);
+    visit(&for_each_primitive);
+    visit(&call_cc_primitive);
+    visit(&apply_code);
+    visit(&map_code);
+    visit(&for_each_code);
+    visit(&call_cc_code);
+}
@@ -3,11 +3,14 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "header/write.h"
 #include "header/object.h"
+#include "header/error.h"
 
-void write(FILE* out, object* obj) {
-    switch(obj->type) {
+/* everything but lists and vectors */
+static void write_atom(FILE* out, object* obj) {
+    switch(type_of(obj)) {
         case THE_EMPTY_LIST:
             fprintf(out, "()");
             break;
@@ -18,38 +21,21 @@ void write(FILE* out, object* obj) {
             fprintf(out, "%s", obj->data.symbol.value);
             break;
         case FIXNUM:
-            fprintf(out, "%ld", obj->data.fixnum.value);
+            fprintf(out, "%ld", fixnum_value(obj));
             break;
         case CHARACTER:
-            if(obj->data.character.value == ' ')
+            if(character_value(obj) == ' ')
                 fprintf(out, "#\\space");
-            else if(obj->data.character.value == '\n')
+            else if(character_value(obj) == '\n')
                 fprintf(out, "#\\newline");
             else
-                fprintf(out, "#\\%c", obj->data.character.value);
+                fprintf(out, "#\\%c", character_value(obj));
             break;
         case STRING:
             fprintf(out, "\"");
-            fprintf(out, "%s", obj->data.string.value);
+            fwrite(obj->data.string.value, 1, obj->data.string.length, out);
             fprintf(out, "\"");
             break;
-        case PAIR:
-            fprintf(out, "(");
-            write_pair(out, obj);
-            fprintf(out, ")");
-            break;
-        case VECTOR: {
-            object* elements = obj->data.vector.elements;
-            fprintf(out, "#(");
-            while(!is_empty_list(elements)) {
-                write(out, car(elements));
-                elements = cdr(elements);
-                if(!is_empty_list(elements))
-                    fprintf(out, " ");
-            }
-            fprintf(out, ")");
-            break;
-        }
         case PORT:
             fprintf(out, "#<port>");
             break;
@@ -65,25 +51,114 @@ void write(FILE* out, object* obj) {
         case COMPOUND_PROC:
             fprintf(out, "#<compound-procedure>");
             break;
+        case NODE:
+            fprintf(out, "#<syntax-node>");
+            break;
+        case CODE:
+            fprintf(out, "#<bytecode>");
+            break;
+        case FRAME:
+            fprintf(out, "#<environment>");
+            break;
+        case BOX:
+            fprintf(out, "#<box>");
+            break;
         default:
             fprintf(stderr, "unknown write type");
     }
 }
 
- void write_pair(FILE* out, object* obj) {
-    object* obj_car = car(obj);
-    object* obj_cdr = cdr(obj);
+/*
+ * A list or vector being written, with what is left of it: the pair
+ * whose car was written last, or the index of the next element.
+ */
+typedef struct {
+    object* obj;
+    size_t index;
+    bool tail_written;  /* the part after the dot of an improper list */
+} write_frame;
 
-    write(out, obj_car);
-    if(obj_cdr->type == PAIR) {
-        fprintf(out, " ");
-        write_pair(out, obj_cdr);
-    }
-    else if(obj_cdr->type == THE_EMPTY_LIST)
-        return;
-    else {
-        fprintf(out, " . ");
-        write(out, obj_cdr);
+typedef struct {
+    write_frame* frames;
+    size_t count;
+    size_t capacity;
+} write_stack;
+
+static void push_write_frame(write_stack* stack, object* obj, size_t index) {
+    if(stack->count == stack->capacity) {
+        size_t capacity = stack->capacity == 0 ? 16 : stack->capacity * 2;
+        write_frame* frames = (write_frame*) realloc(stack->frames, capacity * sizeof(write_frame));
+
+        if(frames == NULL)
+            error_handle(stderr, "out of memory", EXIT_FAILURE);
+        stack->frames = frames;
+        stack->capacity = capacity;
     }
+    stack->frames[stack->count].obj = obj;
+    stack->frames[stack->count].index = index;
+    stack->frames[stack->count].tail_written = false;
+    stack->count++;
+}
 
+/*
+ * Nested lists and vectors are kept on a stack of their own rather than
+ * the C stack, so any depth and length of data can be written.
+ */
+void write(FILE* out, object* obj) {
+    write_stack stack = {NULL, 0, 0};
+
+    for(;;) {
+        /* opens obj, or writes it whole when it is an atom */
+        if(is_pair(obj)) {
+            fprintf(out, "(");
+            push_write_frame(&stack, obj, 0);
+            obj = car(obj);
+            continue;
+        }
+        if(is_vector(obj) && obj->data.vector.length > 0) {
+            fprintf(out, "#(");
+            push_write_frame(&stack, obj, 1);
+            obj = obj->data.vector.elements[0];
+            continue;
+        }
+        if(is_vector(obj))
+            fprintf(out, "#()");
+        else
+            write_atom(out, obj);
+
+        /* closes what is complete and finds the next element to write */
+        obj = NULL;
+        while(stack.count > 0 && obj == NULL) {
+            write_frame* frame = &stack.frames[stack.count - 1];
+
+            if(is_vector(frame->obj)) {
+                if(frame->index < frame->obj->data.vector.length) {
+                    fprintf(out, " ");
+                    obj = frame->obj->data.vector.elements[frame->index++];
+                    continue;
+                }
+            }
+            else if(!frame->tail_written) {
+                object* rest = cdr(frame->obj);
+
+                if(is_pair(rest)) {
+                    fprintf(out, " ");
+                    frame->obj = rest;
+                    obj = car(rest);
+                    continue;
+                }
+                if(!is_empty_list(rest)) {
+                    fprintf(out, " . ");
+                    frame->tail_written = true;
+                    obj = rest;
+                    continue;
+                }
+            }
+            fprintf(out, ")");
+            stack.count--;
+        }
+        if(obj == NULL)
+            break;
+    }
+    free(stack.frames);
 }
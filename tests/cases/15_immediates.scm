@@ -0,0 +1,11 @@
+(eq? #t #t)
+(eq? '() (list))
+(eq? #\a (string-ref "cat" 1))
+(define big (+ 4611686018427387903 1))
+big
+(- big 1)
+(* 4611686018427387903 2)
+(= big 4611686018427387904)
+(eqv? big (+ 4611686018427387903 1))
+(- 0 4611686018427387904 1)
+(char->integer (integer->char 200))
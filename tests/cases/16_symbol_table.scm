@@ -0,0 +1,15 @@
+(define (intern-range i n)
+  (if (< i n)
+      (begin (string->symbol (string-append "sym-" (number->string i)))
+             (intern-range (+ i 1) n))
+      'done))
+(intern-range 0 5000)
+(eq? (string->symbol "sym-4999") 'sym-4999)
+(eq? (string->symbol "sym-17") (string->symbol "sym-17"))
+(eq? 'sym-1 'sym-2)
+(symbol->string (string->symbol "sym-123"))
+(define kept 'survivor)
+(intern-range 0 5000)
+(eq? kept (string->symbol "survivor"))
+(string->symbol (string-append "a" (make-string 1 (integer->char 0)) "b"))
+(eq? (string->symbol "a") 'a)
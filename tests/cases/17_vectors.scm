@@ -0,0 +1,24 @@
+(define v (make-vector 5 'x))
+v
+(make-vector 3)
+(vector-set! v 0 1)
+(vector-fill! v 7 2 4)
+v
+(vector-copy v 1 3)
+(define w (vector-grow v 7))
+w
+(equal? (vector-copy v) v)
+`#(1 ,(+ 1 1) ,@(list 3 4))
+#(1 #(2 3) "s")
+(vector->list (list->vector '(a b c)))
+(vector-grow v 2)
+(vector-fill! v 0 4 2)
+(vector-ref v 5)
+(define big (make-vector 20000 0))
+(define (fill-squares i)
+  (if (< i 20000)
+      (begin (vector-set! big i (* i i)) (fill-squares (+ i 1)))
+      'done))
+(fill-squares 0)
+(vector-ref big 19999)
+(vector-length (vector-grow big 30000))
@@ -0,0 +1,17 @@
+(define s (make-string 5 #\-))
+s
+(string-set! s 0 #\a)
+(string-copy! s 2 "xyz" 1)
+s
+(string-copy! s 1 s 0 3)
+s
+(define z (make-string 3 (integer->char 0)))
+(string-length z)
+(string-length (string-append "ab" z "cd"))
+(char->integer (string-ref (string-append "ab" z "cd") 3))
+(equal? (string-append "a" z) (string-append "a" z))
+(equal? (string-append "a" z) "a")
+(string-length (make-string 0))
+(substring "hello world" 6 11)
+(string-set! s 5 #\q)
+(string-copy! s 4 "long")
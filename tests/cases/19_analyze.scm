@@ -0,0 +1,28 @@
+(define (use-later x) (swap-args list x 1))
+(define-syntax swap-args
+  (syntax-rules ()
+    ((swap-args f a b) (f b a))))
+(use-later 2)
+(use-later 3)
+(define (qq n) `(n ,n ,@(list n n) #(v ,n) `(inner ,(outer ,n))))
+(qq 4)
+(qq 5)
+(define (count-down n acc)
+  (cond ((= n 0) acc)
+        (else (let* ((m (- n 1)) (next (cons m acc))) (count-down m next)))))
+(count-down 5 '())
+(define (counter)
+  (define count 0)
+  (lambda () (set! count (+ count 1)) count))
+(define tick (counter))
+(tick)
+(tick)
+(define (sum-to n)
+  (letrec ((go (lambda (i acc) (if (> i n) acc (go (+ i 1) (+ acc i))))))
+    (go 0 0)))
+(sum-to 100000)
+(define (no-else x) (if x 'yes))
+(no-else #t)
+((lambda args args))
+(and)
+(or)
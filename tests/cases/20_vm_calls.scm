@@ -0,0 +1,34 @@
+(define (apply-loop n) (if (= n 0) 'apply-done (apply apply-loop (list (- n 1)))))
+(apply-loop 2000)
+(define (even-odd n) (if (= n 0) #t (odd-even (- n 1))))
+(define (odd-even n) (if (= n 0) #f (even-odd (- n 1))))
+(even-odd 100001)
+(map (lambda (x y) (* x y)) '(1 2 3) '(4 5 6))
+(map car '((a 1) (b 2)))
+(apply map list '((1 2 3) (4 5 6)))
+(define seen '())
+(for-each (lambda (x) (set! seen (cons x seen))) '(1 2 3))
+seen
+(define (find-first pred lst)
+  (call/cc (lambda (return)
+             (for-each (lambda (x) (if (pred x) (return x))) lst)
+             'none)))
+(find-first (lambda (x) (> x 2)) '(1 2 3 4))
+(find-first (lambda (x) (> x 9)) '(1 2 3 4))
+(+ 1 (call/cc (lambda (k) (map (lambda (x) (if (= x 2) (k 10) x)) '(1 2 3)))))
+(call/cc (lambda (outer) (+ 1 (call/cc (lambda (inner) (outer 5))))))
+(call/cc call/cc)
+(define-syntax twice
+  (syntax-rules ()
+    ((twice e) (begin e e))))
+(define (tick-twice) (define n 0) (twice (set! n (+ n 1))) n)
+(tick-twice)
+(define (splice xs) `(a ,@xs b ,(length xs)))
+(define (length xs) (if (null? xs) 0 (+ 1 (length (cdr xs)))))
+(splice '(1 2))
+`#(1 ,@(list 2 3))
+`(1 ,@2)
+(and 1 #f (car '()))
+(or #f 2 (car '()))
+(map + '(1 2) '(1))
+(apply + 1 2)
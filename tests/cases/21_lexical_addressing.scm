@@ -0,0 +1,55 @@
+(define x 'global)
+(define (shadow x) (lambda (y) (list x y)))
+((shadow 'outer) 'inner)
+(define (parity n)
+  (define (ev? n) (if (= n 0) #t (od? (- n 1))))
+  (define (od? n) (if (= n 0) #f (ev? (- n 1))))
+  (ev? n))
+(parity 10)
+(parity 7)
+(define (make-account balance)
+  (lambda (amount)
+    (set! balance (+ balance amount))
+    balance))
+(define acc (make-account 100))
+(acc 10)
+(acc -30)
+(define (nested a)
+  (let ((b (* a 2)))
+    (let* ((c (+ b 1)) (d (+ c a)))
+      (lambda () (list a b c d x)))))
+((nested 1))
+(define (variadic . rest) rest)
+(define (count-args . args) (define n (length args)) n)
+(define (length l) (if (null? l) 0 (+ 1 (length (cdr l)))))
+(count-args 1 2 3)
+(define (use-before)
+  (define a b)
+  (define b 1)
+  a)
+(use-before)
+(define (redefine-param x) (define x (* x 10)) x)
+(redefine-param 4)
+(define (grouped)
+  (begin (define p 1) (define q 2))
+  (+ p q))
+(grouped)
+(define-syntax define-two
+  (syntax-rules ()
+    ((define-two a b v) (begin (define a v) (define b v)))))
+(define (from-macro)
+  (define-two m n 7)
+  (+ m n))
+(from-macro)
+(define (late-global) (later-defined 5))
+(define (later-defined n) (* n n))
+(late-global)
+(define (set-global!) (set! x 'changed) x)
+(set-global!)
+x
+(define (local-macro n)
+  (define-syntax double
+    (syntax-rules ()
+      ((double e) (* 2 e))))
+  (double n))
+(local-macro 21)
@@ -0,0 +1,28 @@
+(define (add3 a b c) (+ a b c))
+(add3 1 2 3)
+(apply add3 '(4 5 6))
+(add3 1 2)
+(apply add3 '(1 2 3 4))
+(map add3 '(1 2) '(3 4) '(5 6))
+(define (counter)
+  (define n 0)
+  (lambda () (set! n (+ n 1)) n))
+(define c1 (counter))
+(define c2 (counter))
+(c1)
+(c1)
+(c2)
+(define (locals a)
+  (define b (* a 2))
+  (define (scale x) (* x b))
+  (let ((c (+ a b)))
+    (list a b c (scale c))))
+(locals 3)
+(define (collect . xs) (apply + xs))
+(collect)
+(collect 1 2 3 4)
+(define (loop i acc) (if (= i 0) acc (loop (- i 1) (+ acc i))))
+(loop 10000 0)
+(define (no-args) 'done)
+(no-args)
+(no-args 1)
@@ -0,0 +1,20 @@
+(define g 1)
+(define (read-g) g)
+(read-g)
+(define g 2)
+(read-g)
+(set! g 3)
+(read-g)
+(define (bump-g!) (set! g (+ g 1)))
+(bump-g!)
+g
+(define (uses-car l) (car l))
+(uses-car '(a b))
+(define old-car car)
+(define (car l) 'shadowed)
+(uses-car '(a b))
+(define car old-car)
+(uses-car '(a b))
+(set! never-defined 1)
+never-defined
+(environment)
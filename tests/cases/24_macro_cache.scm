@@ -0,0 +1,33 @@
+(define-syntax step
+  (syntax-rules ()
+    ((step x) (+ x 1))))
+(define (next y) (step y))
+(next 1)
+(next 41)
+(define-syntax step
+  (syntax-rules ()
+    ((step x) (* x 10))))
+(next 1)
+(define (step x) 'procedure)
+(next 1)
+(define-syntax swap!
+  (syntax-rules ()
+    ((swap! a b) (let ((tmp a)) (set! a b) (set! b tmp)))))
+(define (shuffle n)
+  (let ((a 1) (b 2))
+    (define (loop i)
+      (if (> i 0)
+          (begin (swap! a b) (loop (- i 1)))
+          (list a b)))
+    (loop n)))
+(shuffle 1000)
+(shuffle 1001)
+(define-syntax my-or
+  (syntax-rules ()
+    ((my-or) #f)
+    ((my-or e) e)
+    ((my-or e r ...) (let ((t e)) (if t t (my-or r ...))))))
+(define (pick x) (my-or (and (eq? x 'a) 'first) (and (eq? x 'c) 'third) 'none))
+(pick 'c)
+(pick 'z)
+(pick 'a)
@@ -0,0 +1,53 @@
+(define-syntax my-let
+  (syntax-rules ()
+    ((_ ((name val) ...) body1 body2 ...)
+     ((lambda (name ...) body1 body2 ...) val ...))))
+(my-let ((a 1) (b 2)) (+ a b))
+(define-syntax my-let*
+  (syntax-rules ()
+    ((_ () body ...) (my-let () body ...))
+    ((_ ((x v) rest ...) body ...) (my-let ((x v)) (my-let* (rest ...) body ...)))))
+(my-let* ((a 1) (b (+ a 1)) (c (* b 10))) (list a b c))
+(define-syntax flatten
+  (syntax-rules ()
+    ((_ (x ...) ...) '(x ... ...))))
+(flatten (1 2) () (3 4 5))
+(define-syntax table
+  (syntax-rules ()
+    ((_ (key val ...) ...) '((key (val ...)) ...))))
+(table (a 1 2) (b) (c 3))
+(define-syntax tag-all
+  (syntax-rules ()
+    ((_ t (x ...)) '((t x) ...))))
+(tag-all item (p q r))
+(define-syntax last-of
+  (syntax-rules ()
+    ((_ x ... y) 'y)))
+(last-of 1 2 3)
+(last-of only)
+(define-syntax my-cond
+  (syntax-rules (else)
+    ((_ (else e)) e)
+    ((_ (c e) clause ...) (if c e (my-cond clause ...)))))
+(my-cond (#f 1) ((= 1 1) 2) (else 3))
+(my-cond (#f 1) (else 3))
+(define-syntax dotted
+  (syntax-rules ()
+    ((_ a . rest) '(a rest))))
+(dotted 1 2 3)
+(define-syntax vec
+  (syntax-rules ()
+    ((_ x ...) #(start x ... end))))
+(vec 1 2)
+(define-syntax zip
+  (syntax-rules ()
+    ((_ (a ...) (b ...)) '((a b) ...))))
+(zip (1 2) (x y))
+(zip (1 2) (x))
+(last-of)
+(define-syntax bad
+  (syntax-rules ()
+    ((_ x ...) 'x)))
+(define-syntax bad
+  (syntax-rules ()
+    ((_ x x) 'x)))
@@ -0,0 +1,26 @@
+(define-syntax my-let
+  (syntax-rules ()
+    ((_ ((name val) ...) body ...) ((lambda (name ...) body ...) val ...))))
+(define-syntax while
+  (syntax-rules ()
+    ((_ test body ...)
+     (my-let ((loop #f))
+       (set! loop (lambda () (if test (begin body ... (loop)) 'done)))
+       (loop)))))
+(define (sum-to n)
+  (my-let ((i 0) (total 0))
+    (while (< i n)
+      (set! i (+ i 1))
+      (set! total (+ total i)))
+    total))
+(sum-to 100)
+(define (never-called) (my-let oops))
+'defined
+(never-called)
+(define (shadowed my-let) (my-let 5))
+(shadowed (lambda (x) (* x 2)))
+(define (uses-later) (later 1 2))
+(define-syntax later
+  (syntax-rules ()
+    ((_ a b) (list b a))))
+(uses-later)
@@ -0,0 +1,30 @@
+(+ 1 2 3)
+(+ 1 2 3 4 5 6 7 8 9 10 11 12)
+(apply + '(1 2 3 4 5 6 7 8 9 10 11 12))
+(apply * '(2 3 4))
+(- 10 1 2 3)
+(-)
+(< 1 2 3)
+(< 1 3 2)
+(> 3 2 1)
+(= 4 4 4)
+(= 4 4 'x)
+(car '(a b))
+(cdr '(a b))
+(car)
+(car '(a) '(b))
+(cdr 5)
+(cons 1 2)
+(map car '((1 2) (3 4)))
+(map + '(1 2) '(10 20))
+(vector-ref (vector 'a 'b 'c) 2)
+(vector-ref (vector 'a 'b 'c) 3)
+(string-ref "abc" 1)
+(string-ref "abc" 'x)
+(eq? 'a 'a)
+(null? '())
+(pair? '())
+(remainder 17 5)
+(/ 7 0)
+(define (sum-list l) (if (null? l) 0 (+ (car l) (sum-list (cdr l)))))
+(sum-list '(1 2 3 4 5))
@@ -0,0 +1,33 @@
+(+ 3 4)
+(- 3 4)
+(* 6 7)
+(< 1 2)
+(< 2 1)
+(> 2 1)
+(= 5 5)
+(= 5 6)
+(eq? "ab" "ab")
+(cons 'a 'b)
+(+ 1 "x")
+(< 'a 1)
+(> 1 'b)
+(* 2 #t)
+(cons 1)
+(cons 1 2 3)
+(=)
+(< 1)
+(quotient 7 2 1)
+(eq? 'a)
+(apply + '(20 22))
+(apply < '(1 2))
+(apply cons '(1))
+(apply car '())
+(define plus +)
+(plus 40 2)
+(define (f op a b) (op a b))
+(f - 50 8)
+(f < 3 2)
+(f cons 1 2)
+(f + 'x 2)
+(define (count-up n acc) (if (= n 0) acc (count-up (- n 1) (+ acc 1))))
+(count-up 10000 0)
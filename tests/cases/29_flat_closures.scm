@@ -0,0 +1,76 @@
+(define (make-counter)
+  (let ((n 0))
+    (lambda () (set! n (+ n 1)) n)))
+(define c1 (make-counter))
+(define c2 (make-counter))
+(c1)
+(c1)
+(c2)
+(define (make-account balance)
+  (define (deposit x) (set! balance (+ balance x)) balance)
+  (define (withdraw x) (set! balance (- balance x)) balance)
+  (lambda (op x)
+    (if (eq? op 'deposit) (deposit x) (withdraw x))))
+(define acc (make-account 100))
+(acc 'deposit 50)
+(acc 'withdraw 30)
+(define (watch)
+  (let ((x 1))
+    (let ((get (lambda () x)))
+      (set! x 2)
+      (get))))
+(watch)
+(define (adder a)
+  (lambda (b)
+    (lambda (c) (+ a b c))))
+(((adder 1) 10) 100)
+(define (evens n)
+  (define (even? k) (if (= k 0) #t (odd? (- k 1))))
+  (define (odd? k) (if (= k 0) #f (even? (- k 1))))
+  (even? n))
+(evens 10)
+(evens 7)
+(letrec ((fact (lambda (k) (if (= k 0) 1 (* k (fact (- k 1)))))))
+  (fact 10))
+(define (deep-set)
+  (let ((v 0))
+    (let ((inc! (lambda () (lambda () (set! v (+ v 1))))))
+      ((inc!))
+      ((inc!))
+      v)))
+(deep-set)
+(define (branch-define flag)
+  (if flag
+      (begin
+        (define (loop i acc) (if (= i 0) acc (loop (- i 1) (+ acc i))))
+        (loop 4 0))
+      'skipped))
+(branch-define #t)
+(branch-define #f)
+(define (thunks n)
+  (if (= n 0)
+      '()
+      (cons (lambda () n) (thunks (- n 1)))))
+(map (lambda (t) (t)) (thunks 3))
+(define (shadow x)
+  (let ((f (lambda (x) (* x 2))))
+    (+ x (f 10))))
+(shadow 1)
+(define (late y)
+  (lambda () (twice y)))
+(define-syntax twice
+  (syntax-rules ()
+    ((twice e) (+ e e))))
+((late 21))
+(define (late-capture y)
+  (lambda () (add-y 1)))
+(define-syntax add-y
+  (syntax-rules ()
+    ((add-y e) (+ e y))))
+((late-capture 5))
+(define (late-assign x)
+  (lambda () (double! x) x))
+(define-syntax double!
+  (syntax-rules ()
+    ((double! v) (set! v (* v 2)))))
+((late-assign 5))
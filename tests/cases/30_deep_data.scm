@@ -0,0 +1,47 @@
+; deep recursion and deep data do not use up the C stack
+
+(define (count-up n)
+  (if (= n 0)
+      0
+      (+ 1 (count-up (- n 1)))))
+(count-up 200000)
+
+(define (iota-from i acc)
+  (if (= i 0)
+      acc
+      (iota-from (- i 1) (cons i acc))))
+(define (iota n) (iota-from n '()))
+
+(define (nest-from i acc)
+  (if (= i 0)
+      acc
+      (nest-from (- i 1) (list acc))))
+(define (nest n) (nest-from n '()))
+
+(define (sum lst)
+  (if (null? lst)
+      0
+      (+ (car lst) (sum (cdr lst)))))
+
+(define long (iota 300000))
+(sum long)
+(equal? long (iota 300000))
+(equal? long (iota 299999))
+
+(define deep (nest 300000))
+(equal? deep (nest 300000))
+(equal? deep (nest 300001))
+(equal? (vector deep 1 "a") (vector (nest 300000) 1 "a"))
+
+(define (depth-from x d)
+  (if (null? x)
+      d
+      (depth-from (car x) (+ d 1))))
+(define (depth x) (depth-from x 0))
+(depth deep)
+(nest 5)
+(iota 10)
+(cons 1 (cons 2 3))
+(vector 1 (list 2 (vector)) '(3 . 4))
+'(a (b #(c (d . e))) . f)
+(depth (car (list (nest 100000))))
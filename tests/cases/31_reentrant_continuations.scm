@@ -0,0 +1,87 @@
+; continuations can be called again after their call/cc returned
+
+(define saved #f)
+(define count 0)
+(+ 100 (call/cc (lambda (k) (set! saved k) 0)))
+(set! count (+ count 1))
+(saved count)
+(saved 7)
+
+; re-entering runs the rest of the computation again
+(define log '())
+(define again #f)
+(define (record x) (set! log (cons x log)) log)
+(record (call/cc (lambda (k) (set! again k) 'first)))
+(again 'second)
+(again 'third)
+
+; generators built on two continuations
+(define (make-generator lst)
+  (define return #f)
+  (define resume #f)
+  (define (start)
+    (for-each (lambda (x)
+                (call/cc (lambda (next)
+                           (set! resume next)
+                           (return x))))
+              lst)
+    (return 'done))
+  (lambda ()
+    (call/cc (lambda (r)
+               (set! return r)
+               (if resume
+                   (resume #f)
+                   (start))))))
+
+(define g (make-generator '(a b c)))
+(g)
+(g)
+(g)
+(g)
+(g)
+
+(define (make-counter n)
+  (define return #f)
+  (define resume #f)
+  (define (start)
+    (define (loop i)
+      (if (> i n)
+          (return 'done)
+          (begin
+            (call/cc (lambda (next) (set! resume next) (return i)))
+            (loop (+ i 1)))))
+    (loop 1))
+  (lambda ()
+    (call/cc (lambda (r)
+               (set! return r)
+               (if resume (resume #f) (start))))))
+
+(define counter (make-counter 100000))
+(define (drain total)
+  (define x (counter))
+  (if (eq? x 'done) total (drain (+ total x))))
+(drain 0)
+
+; two generators interleaved
+(define g1 (make-generator '(1 2 3)))
+(define g2 (make-generator '(x y z)))
+(list (g1) (g2) (g1) (g2) (g1) (g2) (g1) (g2))
+
+; escapes still work and a continuation captured deep in a recursion
+; can be re-entered from outside it
+(define deep-k #f)
+(define (down n)
+  (if (= n 0)
+      (call/cc (lambda (k) (set! deep-k k) 0))
+      (+ 1 (down (- n 1)))))
+(down 10000)
+(deep-k 5)
+(call/cc (lambda (k) (for-each (lambda (x) (if (> x 2) (k x))) '(1 2 3 4)) 'none))
+
+; a continuation called from inside map restarts that map
+(define map-k #f)
+(define (f x) (call/cc (lambda (k) (if (= x 2) (set! map-k k)) x)))
+(define result (map f '(1 2 3)))
+result
+(if (number? (car (cdr result))) (map-k 20) 'done)
+result
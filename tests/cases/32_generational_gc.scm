@@ -0,0 +1,50 @@
+; old objects that are made to point at young ones keep them alive
+
+(define (churn n)
+  (if (= n 0)
+      'done
+      (begin (cons n n) (make-vector 3 n) (churn (- n 1)))))
+
+(define (make-list-of n x acc)
+  (if (= n 0)
+      acc
+      (make-list-of (- n 1) x (cons x acc))))
+
+(define old-pair (cons 'a 'b))
+(define old-vector (make-vector 4 0))
+(define big-vector (make-vector 100 0))
+(define counter 0)
+(define (make-counter)
+  (define count 0)
+  (lambda () (set! count (+ count 1)) (list count)))
+(define tick (make-counter))
+(churn 40000)
+
+(set-car! old-pair (list 1 2 3))
+(set-cdr! old-pair (make-list-of 5 'x '()))
+(vector-set! old-vector 0 (list 'young 'list))
+(vector-set! big-vector 99 (vector 'young 'vector))
+(set! counter (list 'counted))
+(define late (list 'defined 'late))
+(tick)
+(churn 40000)
+
+old-pair
+old-vector
+(vector-ref big-vector 99)
+counter
+late
+(tick)
+(churn 40000)
+(tick)
+
+(define (fill-from i)
+  (if (< i 100)
+      (begin (vector-set! big-vector i (cons i '()))
+             (fill-from (+ i 1)))
+      'filled))
+(fill-from 0)
+(churn 40000)
+(vector-ref big-vector 0)
+(vector-ref big-vector 50)
+(vector-ref big-vector 99)
@@ -0,0 +1,45 @@
+; old data keeps being moved around while the old space is marked
+
+(define (iota-from i acc)
+  (if (= i 0)
+      acc
+      (iota-from (- i 1) (cons i acc))))
+
+(define (sum-from lst acc)
+  (if (null? lst)
+      acc
+      (sum-from (cdr lst) (+ acc (car lst)))))
+(define (sum lst) (sum-from lst 0))
+
+(define (churn n)
+  (if (= n 0)
+      'done
+      (begin (cons n n) (make-vector 3 n) (churn (- n 1)))))
+
+(define left (list (iota-from 100000 '())))
+(define right (list '()))
+(define shelf (make-vector 50 '()))
+
+; hand the list over from one holder to the other and back
+(define (juggle n)
+  (if (= n 0)
+      'juggled
+      (begin
+        (set-car! right (car left))
+        (set-car! left '())
+        (churn 200)
+        (vector-set! shelf (remainder n 50) (car right))
+        (set-car! right '())
+        (churn 200)
+        (set-car! left (vector-ref shelf (remainder n 50)))
+        (vector-set! shelf (remainder n 50) '())
+        (juggle (- n 1)))))
+
+(define more (iota-from 100000 '()))
+(juggle 300)
+(sum (car left))
+(sum more)
+(car right)
+(define kept (iota-from 100000 '()))
+(churn 100000)
+(sum kept)
@@ -0,0 +1,40 @@
+; marking a very long list keeps the C stack and the gray stack flat
+
+(define (iota-from i acc)
+  (if (= i 0)
+      acc
+      (iota-from (- i 1) (cons i acc))))
+
+(define (sum-from lst acc)
+  (if (null? lst)
+      acc
+      (sum-from (cdr lst) (+ acc (car lst)))))
+(define (sum lst) (sum-from lst 0))
+
+(define (churn n)
+  (if (= n 0)
+      'done
+      (begin (cons n n) (churn (- n 1)))))
+
+(define long (iota-from 1000000 '()))
+(churn 300000)
+(sum long)
+
+; lists hanging off the cars of a long list, and a vector of lists
+(define (nest-from i acc)
+  (if (= i 0)
+      acc
+      (nest-from (- i 1) (cons (list i (* i 2)) acc))))
+(define nested (nest-from 200000 '()))
+(define shelf (make-vector 4 '()))
+(vector-set! shelf 0 (iota-from 250000 '()))
+(vector-set! shelf 3 (cdr nested))
+(set! long '())
+(churn 300000)
+(sum (vector-ref shelf 0))
+(car (vector-ref shelf 3))
+(define (second-sum lst acc)
+  (if (null? lst)
+      acc
+      (second-sum (cdr lst) (+ acc (car (cdr (car lst)))))))
+(second-sum nested 0)
@@ -0,0 +1,46 @@
+; a heap big enough for the parallel collector, see TOY_SCHEME_GC_THREADS
+
+(define (iota-from i acc)
+  (if (= i 0)
+      acc
+      (iota-from (- i 1) (cons i acc))))
+
+(define (rows-from i acc)
+  (if (= i 0)
+      acc
+      (rows-from (- i 1) (cons (list->vector (iota-from (remainder i 7) (list i))) acc))))
+
+(define (sum-from lst acc)
+  (if (null? lst)
+      acc
+      (sum-from (cdr lst) (+ acc (car lst)))))
+
+(define (row-sum rows acc)
+  (if (null? rows)
+      acc
+      (row-sum (cdr rows) (+ acc (vector-ref (car rows) (- (vector-length (car rows)) 1))))))
+
+(define (drop lst n)
+  (if (= n 0)
+      lst
+      (drop (cdr lst) (- n 1))))
+
+(define (churn n)
+  (if (= n 0)
+      'done
+      (begin (make-vector 6 n) (churn (- n 1)))))
+
+(define table (rows-from 200000 '()))
+(define spine (iota-from 600000 '()))
+(churn 2000000)
+(row-sum table 0)
+(sum-from spine 0)
+
+; drop half of the data and collect again
+(set! spine (drop spine 300000))
+(set! table (cons (car table) '()))
+(define more (iota-from 1000000 '()))
+(churn 2000000)
+(sum-from spine 0)
+(sum-from more 0)
+(vector->list (car table))
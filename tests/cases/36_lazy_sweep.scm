@@ -0,0 +1,45 @@
+; the old space is swept by the allocator after marking, page by page
+
+(define (iota-from i acc)
+  (if (= i 0)
+      acc
+      (iota-from (- i 1) (cons i acc))))
+
+(define (names-from i acc)
+  (if (= i 0)
+      acc
+      (names-from (- i 1) (cons (string-append "name-" (number->string i)) acc))))
+
+(define (intern-all names acc)
+  (if (null? names)
+      acc
+      (intern-all (cdr names) (cons (string->symbol (car names)) acc))))
+
+(define (count lst acc)
+  (if (null? lst)
+      acc
+      (count (cdr lst) (+ acc 1))))
+
+(define (churn n)
+  (if (= n 0)
+      'done
+      (begin (cons n n) (churn (- n 1)))))
+
+; fill the old space, then drop most of it
+(define names (names-from 60000 '()))
+(define symbols (intern-all names '()))
+(define kept (iota-from 50000 '()))
+(set! names (cons (car names) '()))
+(set! symbols '())
+(churn 400000)
+
+; new old objects take the cells of the dead ones
+(define symbols (intern-all (names-from 60000 '()) '()))
+(define more (iota-from 150000 '()))
+(churn 400000)
+(count symbols 0)
+(count more 0)
+(count kept 0)
+(eq? (car symbols) (string->symbol "name-60000"))
+(eq? (string->symbol (car names)) 'name-1)
+(symbol->string (car (cdr symbols)))
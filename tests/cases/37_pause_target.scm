@@ -0,0 +1,36 @@
+; with a few MB of old objects and a shallow stack, the pauses of the
+; incremental collector stay under GC_PAUSE_TARGET_MS, but for the odd
+; one the scheduler stretches
+
+(define (iota-from i acc)
+  (if (= i 0)
+      acc
+      (iota-from (- i 1) (cons i acc))))
+
+(define (count lst acc)
+  (if (null? lst)
+      acc
+      (count (cdr lst) (+ acc 1))))
+
+; lists that live through a few minor collections, then die old
+(define (generations n kept)
+  (if (= n 0)
+      (count kept 0)
+      (generations (- n 1) (if (= (remainder n 4) 0) (iota-from 20000 '()) (cons n kept)))))
+
+(define table (make-vector 1000 '()))
+(define (fill i)
+  (if (= i 1000)
+      (vector-length table)
+      (begin (vector-set! table i (iota-from 100 '()))
+             (fill (+ i 1)))))
+
+(define long (iota-from 100000 '()))
+(fill 0)
+(generations 200 '())
+(set! long (iota-from 100000 '()))
+(fill 0)
+(generations 200 '())
+(count long 0)
+(count (vector-ref table 999) 0)
+(< (* 1000 (gc-pauses-over-target)) (gc-pauses))